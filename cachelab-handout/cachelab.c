@@ -4,12 +4,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
 #include "cachelab.h"
 #include <time.h>
 
 trans_func_t func_list[MAX_TRANS_FUNCS];
 int func_counter = 0; 
 
+kernel_func_t kernel_list[MAX_KERNELS];
+int kernel_counter = 0;
+
+/* Kernel data: one arena, allocated on first use */
+static char* kernel_arena = NULL;
+static size_t kernel_used = 0;
+
 /* 
  * printSummary - Summarize the cache simulation statistics. Student cache simulators
  *                must call this function in order to be properly autograded. 
@@ -74,6 +82,7 @@ void registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]),
                            char* desc)
 {
     func_list[func_counter].func_ptr = trans;
+    func_list[func_counter].in_place_ptr = NULL;
     func_list[func_counter].description = desc;
     func_list[func_counter].correct = 0;
     func_list[func_counter].num_hits = 0;
@@ -81,3 +90,93 @@ void registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]),
     func_list[func_counter].num_evictions =0;
     func_counter++;
 }
+
+/* 
+ * registerInPlaceFunction - Add the given in-place trans function into
+ *     your list of functions to be tested
+ */
+void registerInPlaceFunction(void (*trans)(int M, int N, int[N][M]), char* desc)
+{
+    registerTransFunction(NULL, desc);
+    func_list[func_counter - 1].in_place_ptr = trans;
+}
+
+/* 
+ * runTransFunction - Run the given function, an in-place one on B (as an
+ *     N x M matrix holding A) rather than from A to B
+ */
+void runTransFunction(trans_func_t* f, int M, int N, int A[N][M], int B[M][N])
+{
+    if (f->in_place_ptr)
+        (*f->in_place_ptr)(M, N, (int (*)[M]) B);
+    else
+        (*f->func_ptr)(M, N, A, B);
+}
+
+/* 
+ * registerKernel - Add the given kernel into the list of kernels to be
+ *     evaluated, parsing its "name=value ..." parameter list
+ */
+void registerKernel(void (*setup)(int params[], void* bufs[]),
+                    size_t (*data_size)(int params[]),
+                    void (*run)(int params[], void* bufs[]), char* desc, char* params)
+{
+    kernel_func_t* k = &kernel_list[kernel_counter];
+    char name[32];
+    int value, len;
+
+    assert(kernel_counter < MAX_KERNELS);
+    k->setup = setup;
+    k->data_size = data_size;
+    k->run = run;
+    k->description = desc;
+    k->num_params = 0;
+    while (sscanf(params, " %31[^= ]=%d%n", name, &value, &len) == 2) {
+        assert(k->num_params < MAX_KERNEL_PARAMS);
+        k->param_names[k->num_params] = malloc(strlen(name) + 1);
+        assert(k->param_names[k->num_params]);
+        strcpy(k->param_names[k->num_params], name);
+        k->params[k->num_params++] = value;
+        params += len;
+    }
+    kernel_counter++;
+}
+
+/* 
+ * kernelAlloc - Allocate kernel data from the arena
+ */
+void* kernelAlloc(size_t size)
+{
+    void* p;
+
+    if (kernel_arena == NULL) {
+        kernel_arena = malloc(KERNEL_ARENA_SIZE);
+        assert(kernel_arena);
+    }
+    kernel_used = (kernel_used + 63) & ~(size_t) 63;
+    if (size > KERNEL_ARENA_SIZE - kernel_used) {
+        printf("Error: kernel data exceeds %d MB\n", KERNEL_ARENA_SIZE >> 20);
+        exit(1);
+    }
+    p = kernel_arena + kernel_used;
+    kernel_used += size;
+    return p;
+}
+
+/* 
+ * kernelReset - Free all kernel data at once
+ */
+void kernelReset(void)
+{
+    kernel_used = 0;
+}
+
+/* 
+ * kernelArena - The arena's start (NULL before the first kernelAlloc)
+ *     and size
+ */
+char* kernelArena(size_t* size)
+{
+    *size = kernel_arena ? KERNEL_ARENA_SIZE : 0;
+    return kernel_arena;
+}
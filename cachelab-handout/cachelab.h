@@ -5,10 +5,13 @@
 #ifndef CACHELAB_TOOLS_H
 #define CACHELAB_TOOLS_H
 
+#include <stddef.h>
+
 #define MAX_TRANS_FUNCS 100
 
 typedef struct trans_func{
   void (*func_ptr)(int M,int N,int[N][M],int[M][N]);
+  void (*in_place_ptr)(int M,int N,int[N][M]); /* instead, for in-place functions */
   char* description;
   char correct;
   unsigned int num_hits;
@@ -16,6 +19,28 @@ typedef struct trans_func{
   unsigned int num_evictions;
 } trans_func_t;
 
+#define MAX_KERNELS 100
+#define MAX_KERNEL_PARAMS 4
+#define MAX_KERNEL_BUFS 4
+
+#define KERNEL_ARENA_SIZE (64 << 20) /* bytes kernelAlloc can hand out */
+
+/*
+ * A memory kernel other than a transpose (test-trans -K). setup gets the
+ * parameters and fills bufs with buffers from kernelAlloc, unevaluated;
+ * run is the code whose accesses to those buffers are evaluated.
+ * data_size is the bytes setup will allocate, checked before it runs.
+ */
+typedef struct kernel_func{
+  void (*setup)(int params[], void* bufs[]);
+  size_t (*data_size)(int params[]);
+  void (*run)(int params[], void* bufs[]);
+  char* description;
+  int num_params;
+  char* param_names[MAX_KERNEL_PARAMS];
+  int params[MAX_KERNEL_PARAMS];
+} kernel_func_t;
+
 /* 
  * printSummary - This function provides a standard way for your cache
  * simulator * to display its final hit and miss statistics
@@ -34,4 +59,36 @@ void correctTrans(int M, int N, int A[N][M], int B[M][N]);
 void registerTransFunction(
     void (*trans)(int M,int N,int[N][M],int[M][N]), char* desc);
 
+/* Add the given in-place function, which transposes A into its own memory */
+void registerInPlaceFunction(
+    void (*trans)(int M,int N,int[N][M]), char* desc);
+
+/* Scratch state of the in-place functions (trans.c): tracegen records its
+   address in .marker after A and B, and test-trans counts its accesses */
+#define IN_PLACE_MAX (256 * 256)
+struct in_place_scratch {
+  unsigned char moved[IN_PLACE_MAX / 8]; /* one bit per element */
+  int saved[256];                        /* the run a cycle starts from */
+};
+extern struct in_place_scratch in_place_scratch;
+
+/* Run the given function on A and B; an in-place function transposes B,
+   which must already hold a copy of A */
+void runTransFunction(trans_func_t* f, int M, int N, int A[N][M], int B[M][N]);
+
+/* Add the given kernel, with the function giving the bytes its setup
+   allocates, and parameter names and defaults given as "name=value ...",
+   e.g. "n=32 b=8" */
+void registerKernel(void (*setup)(int params[], void* bufs[]),
+    size_t (*data_size)(int params[]),
+    void (*run)(int params[], void* bufs[]), char* desc, char* params);
+
+/* Allocate size bytes of kernel data, 64-byte aligned within the arena
+   (exits if it is full); kernelReset frees everything allocated */
+void* kernelAlloc(size_t size);
+void kernelReset(void);
+
+/* The arena kernelAlloc allocates from, and its size */
+char* kernelArena(size_t* size);
+
 #endif /* CACHELAB_TOOLS_H */
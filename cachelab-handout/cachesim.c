@@ -0,0 +1,492 @@
+/*
+ * cachesim.c - Set-associative cache with pluggable replacement policies
+ */
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "cachesim.h"
+
+#define ADDR_LEN 64
+
+char* policyNames[NUM_POLICIES] = {"lru", "fifo", "random", "plru", "srrip", "brrip", "lfu"};
+
+#define RRPV_MAX 3          // 2-bit re-reference prediction values
+#define BRRIP_LONG_ODDS 32  // BRRIP inserts at RRPV_MAX - 1 once in this many fills
+
+/*
+Seeds the per-set random state of local set setI from its global set index,
+so a set draws the same victims whichever cache (serial, a -j worker's or a
+set sample's) simulates it.
+*/
+void seedSet(cache_t* cache, addr_t setI, addr_t set) {
+    if (cache->policy == POLICY_RANDOM || cache->policy == POLICY_BRRIP) {
+        cache->setMeta[setI] = (uint32_t) ((set * 0x9E3779B97F4A7C15ULL) >> 32) | 1;
+    }
+}
+
+
+/*
+Seeds local sets 0, 1, ... as global sets firstSet, firstSet + stride, ...
+*/
+void seedSets(cache_t* cache, addr_t firstSet, addr_t stride) {
+    for (addr_t i = 0; i < cache->numSets; i += 1) {
+        seedSet(cache, i, firstSet + i * stride);
+    }
+}
+
+
+/* Frees whatever initCache got and zeroes cache, so that freeing it again is safe */
+static int initFailed(cache_t* cache) {
+    freeCache(cache);
+    memset(cache, 0, sizeof(cache_t));
+    return -1;
+}
+
+
+/*
+Allocates one array per field for numSets * associativity lines, plus
+whatever metadata policy keeps. All lines start invalid and every set's LRU
+list starts empty.
+*/
+int initCache(cache_t* cache, addr_t numSets, int associativity, policy_t policy) {
+    addr_t numLines = numSets * associativity;
+
+    cache->numSets = numSets;
+    cache->associativity = associativity;
+    cache->policy = policy;
+    cache->tags = (addr_t*) calloc(numLines, sizeof(addr_t));
+    cache->isValid = (bool*) calloc(numLines, sizeof(bool));
+    cache->isDirty = (bool*) calloc(numLines, sizeof(bool));
+    cache->numValid = (int*) calloc(numSets, sizeof(int));
+    cache->newer = cache->older = cache->mru = cache->lru = NULL;
+    cache->lineMeta = cache->setMeta = NULL;
+    if (!cache->tags || !cache->isValid || !cache->isDirty || !cache->numValid) {
+        return initFailed(cache);
+    }
+    if (policy == POLICY_LRU) {
+        cache->newer = (int*) malloc(sizeof(int) * numLines);
+        cache->older = (int*) malloc(sizeof(int) * numLines);
+        cache->mru = (int*) malloc(sizeof(int) * numSets);
+        cache->lru = (int*) malloc(sizeof(int) * numSets);
+        if (!cache->newer || !cache->older || !cache->mru || !cache->lru) {
+            return initFailed(cache);
+        }
+        for (addr_t i = 0; i < numSets; i += 1) {
+            cache->mru[i] = -1;
+            cache->lru[i] = -1;
+        }
+    } else {
+        cache->lineMeta = (uint32_t*) calloc(numLines, sizeof(uint32_t));
+        cache->setMeta = (uint32_t*) calloc(numSets, sizeof(uint32_t));
+        if (!cache->lineMeta || !cache->setMeta) {
+            return initFailed(cache);
+        }
+        seedSets(cache, 0, 1);
+    }
+    return 0;
+}
+
+
+/* Unlink way from its set's LRU list */
+static inline void lruRemove(cache_t* cache, addr_t setI, int way) {
+    addr_t base = setI * cache->associativity;
+    int newer = cache->newer[base + way];
+    int older = cache->older[base + way];
+
+    if (newer != -1) {
+        cache->older[base + newer] = older;
+    } else {
+        cache->mru[setI] = older;
+    }
+    if (older != -1) {
+        cache->newer[base + older] = newer;
+    } else {
+        cache->lru[setI] = newer;
+    }
+}
+
+
+/* Link way in as the most recently used line of its set */
+static inline void lruPushMru(cache_t* cache, addr_t setI, int way) {
+    addr_t base = setI * cache->associativity;
+    int oldMru = cache->mru[setI];
+
+    cache->newer[base + way] = -1;
+    cache->older[base + way] = oldMru;
+    if (oldMru != -1) {
+        cache->newer[base + oldMru] = way;
+    } else {
+        cache->lru[setI] = way;
+    }
+    cache->mru[setI] = way;
+}
+
+
+/*
+Returns the way holding tag in set setI, or -1. Tags are compared several at
+a time with SSE2 when the set is wide enough to make it pay off; a lane only
+counts as a hit if the line is also valid.
+*/
+int findLine(cache_t* cache, addr_t setI, addr_t tag) {
+    int associativity = cache->associativity;
+    const addr_t* tags = cache->tags + setI * associativity;
+    const bool* isValid = cache->isValid + setI * associativity;
+    int j = 0;
+
+#ifdef __SSE2__
+    // 64-bit equality from 32-bit compares: both halves of a lane must match
+    __m128i needle = _mm_set1_epi64x((long long) tag);
+    for (; j + 2 <= associativity; j += 2) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (tags + j)), needle);
+        eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(eq));
+        if ((mask & 1) && isValid[j]) {
+            return j;
+        }
+        if ((mask & 2) && isValid[j + 1]) {
+            return j + 1;
+        }
+    }
+#endif
+    for (; j < associativity; j += 1) {
+        if (isValid[j] && tags[j] == tag) {
+            return j;
+        }
+    }
+    return -1;
+}
+
+
+static inline uint32_t xorshift32(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+
+/* Points every tree-PLRU node on way's path away from it */
+static inline void plruTouch(uint32_t* nodes, int associativity, int way) {
+    for (int n = associativity + way; n > 1; n /= 2) {
+        nodes[n / 2] = (n % 2 == 0); // came from the left: replace right next
+    }
+}
+
+
+/* Updates replacement state after a hit on way */
+void policyHit(cache_t* cache, addr_t setI, int way) {
+    uint32_t* meta = cache->lineMeta + setI * cache->associativity;
+
+    switch (cache->policy) {
+        case POLICY_LRU:
+            lruRemove(cache, setI, way);
+            lruPushMru(cache, setI, way);
+            break;
+        case POLICY_PLRU:
+            plruTouch(meta, cache->associativity, way);
+            break;
+        case POLICY_SRRIP:
+        case POLICY_BRRIP:
+            meta[way] = 0;
+            break;
+        case POLICY_LFU:
+            if (meta[way] != UINT32_MAX) {
+                meta[way] += 1;
+            }
+            break;
+        default: // FIFO and random ignore hits
+            break;
+    }
+}
+
+
+/* Sets up replacement state for a line just filled into way */
+static inline void policyFill(cache_t* cache, addr_t setI, int way) {
+    uint32_t* meta = cache->lineMeta + setI * cache->associativity;
+
+    switch (cache->policy) {
+        case POLICY_LRU:
+            lruPushMru(cache, setI, way);
+            break;
+        case POLICY_FIFO:
+            meta[way] = cache->setMeta[setI]++;
+            break;
+        case POLICY_PLRU:
+            plruTouch(meta, cache->associativity, way);
+            break;
+        case POLICY_SRRIP:
+            meta[way] = RRPV_MAX - 1;
+            break;
+        case POLICY_BRRIP:
+            meta[way] = (xorshift32(&cache->setMeta[setI]) % BRRIP_LONG_ODDS == 0) ? RRPV_MAX - 1 : RRPV_MAX;
+            break;
+        case POLICY_LFU:
+            meta[way] = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+
+/*
+Picks the way to evict from a full set. LRU also unlinks it; the caller
+refills it with policyFill.
+*/
+static inline int policyVictim(cache_t* cache, addr_t setI) {
+    int associativity = cache->associativity;
+    uint32_t* meta = cache->lineMeta + setI * associativity;
+    int way;
+
+    switch (cache->policy) {
+        case POLICY_LRU:
+            way = cache->lru[setI];
+            lruRemove(cache, setI, way);
+            return way;
+        case POLICY_FIFO: {
+            // Oldest fill; unsigned differences stay right across wraparound
+            int victim = 0;
+            uint32_t now = cache->setMeta[setI];
+            for (way = 1; way < associativity; way += 1) {
+                if (now - meta[way] > now - meta[victim]) {
+                    victim = way;
+                }
+            }
+            return victim;
+        }
+        case POLICY_RANDOM:
+            return xorshift32(&cache->setMeta[setI]) % associativity;
+        case POLICY_PLRU: {
+            int n = 1;
+            while (n < associativity) {
+                n = 2 * n + meta[n];
+            }
+            return n - associativity;
+        }
+        case POLICY_SRRIP:
+        case POLICY_BRRIP:
+            // Oldest predicted re-reference first; age the set until one is distant
+            for (;;) {
+                for (way = 0; way < associativity; way += 1) {
+                    if (meta[way] >= RRPV_MAX) {
+                        return way;
+                    }
+                }
+                for (way = 0; way < associativity; way += 1) {
+                    meta[way] += 1;
+                }
+            }
+        case POLICY_LFU: {
+            int victim = 0;
+            for (way = 1; way < associativity; way += 1) {
+                if (meta[way] < meta[victim]) {
+                    victim = way;
+                }
+            }
+            return victim;
+        }
+        default:
+            abort();
+    }
+}
+
+
+/*
+Puts tag, which must not be in the set, into a non-valid line if there is
+one (returns 1) or in place of the policy's victim (returns 2, with the
+victim's tag and dirty bit in *victimTag and *victimDirty). The way used
+goes in *wayOut.
+*/
+int insertLine(cache_t* cache, addr_t setI, addr_t tag, bool dirty,
+               addr_t* victimTag, bool* victimDirty, int* wayOut) {
+    int associativity = cache->associativity;
+    addr_t base = setI * associativity;
+    int way;
+    int result;
+
+    if (cache->numValid[setI] < associativity) {
+        for (way = 0; cache->isValid[base + way]; way += 1);
+        cache->isValid[base + way] = true;
+        cache->numValid[setI] += 1;
+        result = 1; // miss
+    } else {
+        way = policyVictim(cache, setI);
+        *victimTag = cache->tags[base + way];
+        *victimDirty = cache->isDirty[base + way];
+        result = 2; // miss eviction
+    }
+    cache->tags[base + way] = tag;
+    cache->isDirty[base + way] = dirty;
+    policyFill(cache, setI, way);
+    *wayOut = way;
+    return result;
+}
+
+
+/*
+Results in either hit (pull/push data from data cache),
+miss (data not in cache, pull from memory and replace !isValid line / push to
+!isValid line), or miss + evict (data not in cache and replace the line the
+replacement policy picks)
+*/
+int load(cache_t* cache, addr_t setI, addr_t tag) {
+    int way = findLine(cache, setI, tag);
+    if (way != -1) {
+        policyHit(cache, setI, way);
+        return 0; // hit
+    }
+    addr_t victimTag;
+    bool victimDirty;
+    return insertLine(cache, setI, tag, false, &victimTag, &victimDirty, &way);
+}
+
+
+/* Drops way from set setI, e.g. when an inclusive lower level evicts it */
+void invalidateLine(cache_t* cache, addr_t setI, int way) {
+    addr_t line = setI * cache->associativity + way;
+
+    if (cache->policy == POLICY_LRU) {
+        lruRemove(cache, setI, way);
+    }
+    cache->isValid[line] = false;
+    cache->isDirty[line] = false;
+    cache->numValid[setI] -= 1;
+}
+
+
+void freeCache(cache_t* cache) {
+    free(cache->tags);
+    free(cache->isValid);
+    free(cache->isDirty);
+    free(cache->newer);
+    free(cache->older);
+    free(cache->mru);
+    free(cache->lru);
+    free(cache->numValid);
+    free(cache->lineMeta);
+    free(cache->setMeta);
+}
+
+
+
+int cacheSimInit(cachesim_t* sim, int setBits, int associativity, int blockBits, policy_t policy) {
+    int tagBits = ADDR_LEN - setBits - blockBits;
+
+    memset(sim, 0, sizeof(cachesim_t));
+    if (setBits >= ADDR_LEN || tagBits < 0) {
+        return -1;
+    }
+    sim->blockBits = blockBits;
+    sim->tagShift = blockBits + setBits;
+    sim->setMask = ~(0xffffffffffffffff << setBits);
+    sim->tagMask = ~(0xffffffffffffffff << tagBits);
+    return initCache(&sim->cache, (addr_t) 1 << setBits, associativity, policy);
+}
+
+
+int cacheSimAccess(cachesim_t* sim, addr_t addr) {
+    addr_t tag = (addr >> sim->tagShift) & sim->tagMask;
+    addr_t setIndex = (addr >> sim->blockBits) & sim->setMask;
+    int result = load(&sim->cache, setIndex, tag);
+
+    if (result == 0) {
+        sim->hits += 1;
+    } else {
+        sim->misses += 1;
+        sim->evictions += (result == 2);
+    }
+    return result;
+}
+
+
+void cacheSimFree(cachesim_t* sim) {
+    freeCache(&sim->cache);
+}
+
+
+int mapInit(addr_map_t* map, size_t expected) {
+    map->size = 0;
+    map->hasOnes = false;
+    for (map->cap = 16; map->cap < 2 * expected; map->cap *= 2) {
+    }
+    map->keys = calloc(map->cap, sizeof(addr_t));
+    map->vals = malloc(map->cap * sizeof(int));
+    return (map->keys && map->vals) ? 0 : -1;
+}
+
+
+/* Returns the slot of key: where it is, or where it would go */
+static inline size_t mapSlot(const addr_map_t* map, addr_t key) {
+    size_t h = hashAddr(key, map->cap);
+    while (map->keys[h] != 0 && map->keys[h] != key + 1) {
+        h = (h + 1) & (map->cap - 1);
+    }
+    return h;
+}
+
+
+int mapFind(const addr_map_t* map, addr_t key) {
+    if (key == ~0ULL) {
+        return map->hasOnes ? map->onesVal : -1;
+    }
+    size_t h = mapSlot(map, key);
+    return map->keys[h] != 0 ? map->vals[h] : -1;
+}
+
+
+static int mapGrow(addr_map_t* map) {
+    addr_map_t bigger = {calloc(map->cap * 2, sizeof(addr_t)), malloc(map->cap * 2 * sizeof(int)),
+                         map->cap * 2, map->size, map->hasOnes, map->onesVal};
+    if (bigger.keys == NULL || bigger.vals == NULL) {
+        free(bigger.keys);
+        free(bigger.vals);
+        return -1;
+    }
+    for (size_t i = 0; i < map->cap; i += 1) {
+        if (map->keys[i] != 0) {
+            size_t h = mapSlot(&bigger, map->keys[i] - 1);
+            bigger.keys[h] = map->keys[i];
+            bigger.vals[h] = map->vals[i];
+        }
+    }
+    free(map->keys);
+    free(map->vals);
+    *map = bigger;
+    return 0;
+}
+
+
+int mapFindOrAdd(addr_map_t* map, addr_t key, int* val) {
+    if (key == ~0ULL) {
+        if (map->hasOnes) {
+            *val = map->onesVal;
+            return 1;
+        }
+        map->hasOnes = true;
+        map->onesVal = *val;
+        return 0;
+    }
+    size_t h = mapSlot(map, key);
+    if (map->keys[h] != 0) {
+        *val = map->vals[h];
+        return 1;
+    }
+    map->keys[h] = key + 1;
+    map->vals[h] = *val;
+    map->size += 1;
+    if (map->size * 2 > map->cap && mapGrow(map) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+
+void mapFree(addr_map_t* map) {
+    free(map->keys);
+    free(map->vals);
+    map->keys = NULL;
+    map->vals = NULL;
+}
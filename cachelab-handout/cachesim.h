@@ -0,0 +1,173 @@
+/*
+ * cachesim.h - The set-associative cache model behind csim and test-trans
+ *
+ * There are two layers. cacheSim* takes whole addresses and keeps the
+ * hits, misses and evictions csim reports. Under it, a cache_t is indexed
+ * by set and tag directly, for callers that split addresses themselves
+ * (csim -j workers own a subset of the sets, and hierarchy levels need to
+ * move individual lines between caches).
+ */
+
+#ifndef CACHESIM_H
+#define CACHESIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "traceio.h"
+
+/* Replacement policies, selected with csim -p */
+typedef enum policy {
+    POLICY_LRU,
+    POLICY_FIFO,
+    POLICY_RANDOM,
+    POLICY_PLRU,     // tree pseudo-LRU, E must be a power of two
+    POLICY_SRRIP,    // static re-reference interval prediction, 2-bit
+    POLICY_BRRIP,    // bimodal RRIP: SRRIP that mostly inserts at distant
+    POLICY_LFU,
+    NUM_POLICIES
+} policy_t;
+
+extern char* policyNames[NUM_POLICIES];
+
+/*
+Cache storage is flat: line (set, way) lives at index set * E + way in each
+of the per-line arrays, so every set is one contiguous run and nothing is
+allocated per set. LRU order is kept as a doubly linked list of ways per set
+(mru -> ... -> lru), so both touching a line and picking the victim are O(1)
+regardless of associativity. The other policies keep one word per line
+and/or one word per set instead:
+
+    fifo    lineMeta: fill sequence number of the way; setMeta: fills so far
+    random  setMeta: xorshift32 state, seeded from the set index
+    plru    lineMeta[1 .. E-1]: tree nodes, 1 = replace in the right half
+    srrip   lineMeta: RRPV of the way
+    brrip   lineMeta: RRPV of the way; setMeta: xorshift32 state
+    lfu     lineMeta: access count of the way
+*/
+typedef struct cache {
+    addr_t numSets;
+    int associativity;
+    policy_t policy;
+    addr_t* tags;    // per line: tag
+    bool* isValid;   // per line: valid bit
+    bool* isDirty;   // per line: modified since filled (write-back hierarchies only)
+    int* numValid;   // per set: number of valid lines
+
+    // LRU only
+    int* newer;      // per line: next more recently used way in the set, -1 if mru
+    int* older;      // per line: next less recently used way in the set, -1 if lru
+    int* mru;        // per set: most recently used way, -1 if set is empty
+    int* lru;        // per set: least recently used way, -1 if set is empty
+
+    // Other policies
+    uint32_t* lineMeta;
+    uint32_t* setMeta;
+} cache_t;
+
+/* A cache addressed by whole addresses, with its running totals */
+typedef struct cachesim {
+    cache_t cache;
+    int blockBits;
+    int tagShift;
+    addr_t setMask;
+    addr_t tagMask;
+    unsigned long hits, misses, evictions;
+} cachesim_t;
+
+/*
+ * cacheSimInit - Set up an empty cache of 2^setBits sets of associativity
+ *     2^blockBits-byte lines with the given policy (plru needs a power of
+ *     two associativity). Returns 0, or -1 if out of memory.
+ */
+int cacheSimInit(cachesim_t* sim, int setBits, int associativity, int blockBits, policy_t policy);
+
+/*
+ * cacheSimAccess - Look up addr, loading its block on a miss, and count
+ *     the result. Returns 0 for a hit, 1 for a miss, 2 for a miss that
+ *     evicted a line. A modify ('M') is two accesses.
+ */
+int cacheSimAccess(cachesim_t* sim, addr_t addr);
+
+/* cacheSimFree - Release the cache; the totals stay readable */
+void cacheSimFree(cachesim_t* sim);
+
+/*
+ * initCache - Allocate numSets * associativity invalid lines, plus whatever
+ *     metadata policy keeps. Returns 0, or -1 if out of memory, leaving the
+ *     cache zeroed (freeCache on it does nothing).
+ */
+int initCache(cache_t* cache, addr_t numSets, int associativity, policy_t policy);
+
+/*
+ * seedSets - Seed the random state of local sets 0, 1, ... as if they were
+ *     global sets firstSet, firstSet + stride, ...
+ */
+void seedSets(cache_t* cache, addr_t firstSet, addr_t stride);
+
+/* seedSet - Seed the random state of local set setI as global set set */
+void seedSet(cache_t* cache, addr_t setI, addr_t set);
+
+/* load - Access tag in set setI; returns 0 hit, 1 miss, 2 miss eviction */
+int load(cache_t* cache, addr_t setI, addr_t tag);
+
+/* findLine - The way holding tag in set setI, or -1 */
+int findLine(cache_t* cache, addr_t setI, addr_t tag);
+
+/* policyHit - Update the replacement state for a hit on way */
+void policyHit(cache_t* cache, addr_t setI, int way);
+
+/*
+ * insertLine - Put tag, which must not be in set setI, into a non-valid
+ *     line (returns 1) or in place of the policy's victim (returns 2, with
+ *     the victim's tag and dirty bit in *victimTag and *victimDirty). The
+ *     way used goes in *wayOut.
+ */
+int insertLine(cache_t* cache, addr_t setI, addr_t tag, bool dirty,
+               addr_t* victimTag, bool* victimDirty, int* wayOut);
+
+/* invalidateLine - Drop way from set setI */
+void invalidateLine(cache_t* cache, addr_t setI, int way);
+
+/* freeCache - Release everything initCache allocated */
+void freeCache(cache_t* cache);
+
+/*
+Address -> int map for the tools that track blocks, sets or pages by number
+(stack distances, miss attribution, set sampling). Open addressing with
+linear probing on a Fibonacci hash of the key; a slot holds key + 1 so that
+0 marks it empty. Key ~0, which would wrap to 0, is kept outside the table.
+The table doubles when it gets half full.
+*/
+typedef struct addr_map {
+    addr_t* keys;
+    int* vals;
+    size_t cap;      // power of two
+    size_t size;     // keys in the table
+    bool hasOnes;    // key ~0 is in the map, with value onesVal
+    int onesVal;
+} addr_map_t;
+
+/* hashAddr - Fibonacci hash of key into a table of cap (a power of two) slots */
+static inline size_t hashAddr(addr_t key, size_t cap) {
+    return (size_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32) & (cap - 1);
+}
+
+/*
+ * mapInit - Empty map with room for expected keys before it first grows.
+ *     Returns 0, or -1 if out of memory (the map is then safe to free).
+ */
+int mapInit(addr_map_t* map, size_t expected);
+
+/* mapFind - The value of key, or -1 if it is not in the map */
+int mapFind(const addr_map_t* map, addr_t key);
+
+/*
+ * mapFindOrAdd - Look key up, adding it with value *val if absent. Returns
+ *     1 if it was there (its value in *val), 0 if added, -1 if out of memory.
+ */
+int mapFindOrAdd(addr_map_t* map, addr_t key, int* val);
+
+/* mapFree - Release the map's table */
+void mapFree(addr_map_t* map);
+
+#endif /* CACHESIM_H */
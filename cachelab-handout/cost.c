@@ -0,0 +1,110 @@
+/*
+ * cost.c - Latency and bandwidth bounds on the time of simulated accesses
+ */
+#include <stdio.h>
+#include <string.h>
+#include "cost.h"
+
+static const cost_level_t defaultCaches[COST_MAX_CACHES] = {
+    {4, 64}, {14, 32}, {50, 16}, {80, 16}
+};
+static const cost_level_t defaultMem = {200, 8};
+
+
+void costInit(cost_model_t* model) {
+    memcpy(model->caches, defaultCaches, sizeof(defaultCaches));
+    model->mem = defaultMem;
+}
+
+
+int costParse(cost_model_t* model, const char* spec) {
+    char name[8];
+    double latency, bandwidth = -1;
+    cost_level_t* level;
+    int level1 = 0;
+    int used = 0, usedBw = 0;
+
+    // %n checks that nothing follows the numbers; !(x >= 0) also catches nan
+    if (sscanf(spec, "%7[^=]=%lf%n", name, &latency, &used) < 2 || !(latency >= 0)) {
+        return -1;
+    }
+    if (spec[used] == ':') {
+        if (sscanf(spec + used, ":%lf%n", &bandwidth, &usedBw) < 1 || !(bandwidth > 0)) {
+            return -1;
+        }
+        used += usedBw;
+    }
+    if (spec[used] != '\0') {
+        return -1;
+    }
+    if (strcmp(name, "mem") == 0) {
+        level = &model->mem;
+    } else if (name[0] == 'L' && name[1] >= '1' && name[1] <= '0' + COST_MAX_CACHES && name[2] == '\0') {
+        level1 = name[1] - '0';
+        level = &model->caches[level1 - 1];
+    } else {
+        return -1;
+    }
+    level->latency = latency;
+    if (bandwidth > 0) {
+        level->bandwidth = bandwidth;
+    }
+    return level1;
+}
+
+
+static const cost_level_t* levelOf(const cost_model_t* model, int i, int numCaches) {
+    return (i < numCaches) ? &model->caches[i] : &model->mem;
+}
+
+
+void costEstimate(const cost_model_t* model, const cost_usage_t usage[], int numCaches,
+                  unsigned long accesses, double extraCycles, cost_estimate_t* est) {
+    memset(est, 0, sizeof(cost_estimate_t));
+    est->latencyCycles = extraCycles;
+    for (int i = 0; i <= numCaches; i += 1) {
+        const cost_level_t* lvl = levelOf(model, i, numCaches);
+        double busy = usage[i].bytes / lvl->bandwidth;
+        est->latencyCycles += usage[i].lookups * lvl->latency;
+        if (busy > est->bandwidthCycles) {
+            est->bandwidthCycles = busy;
+            est->bottleneck = i;
+        }
+    }
+    est->cycles = (est->latencyCycles > est->bandwidthCycles) ? est->latencyCycles : est->bandwidthCycles;
+    est->stallCycles = est->cycles - (double) accesses * model->caches[0].latency;
+    if (est->stallCycles < 0) {
+        est->stallCycles = 0;
+    }
+    est->amat = accesses ? est->latencyCycles / accesses : 0.0;
+}
+
+
+void costPrint(FILE* fp, const cost_model_t* model, const cost_usage_t usage[], int numCaches,
+               unsigned long accesses, double extraCycles) {
+    cost_estimate_t est;
+    char name[16];
+
+    costEstimate(model, usage, numCaches, accesses, extraCycles, &est);
+    fprintf(fp, "%-5s %8s %8s %12s %14s %14s\n", "level", "latency", "B/cycle", "lookups", "bytes", "busy cycles");
+    for (int i = 0; i <= numCaches; i += 1) {
+        const cost_level_t* lvl = levelOf(model, i, numCaches);
+        if (i < numCaches) {
+            sprintf(name, "L%d", i + 1);
+        } else {
+            strcpy(name, "mem");
+        }
+        fprintf(fp, "%-5s %8g %8g %12lu %14llu %14.0f\n", name, lvl->latency, lvl->bandwidth,
+                usage[i].lookups, usage[i].bytes, usage[i].bytes / lvl->bandwidth);
+    }
+    if (extraCycles > 0) {
+        fprintf(fp, "translation: %.0f cycles\n", extraCycles);
+    }
+    if (est.bottleneck < numCaches) {
+        sprintf(name, "L%d", est.bottleneck + 1);
+    } else {
+        strcpy(name, "mem");
+    }
+    fprintf(fp, "AMAT:%.2f cycles latency-bound:%.0f bandwidth-bound:%.0f (%s) estimated:%.0f stalls:%.0f\n",
+            est.amat, est.latencyCycles, est.bandwidthCycles, name, est.cycles, est.stallCycles);
+}
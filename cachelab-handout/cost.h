@@ -0,0 +1,71 @@
+/*
+ * cost.h - A cycle-approximate cost model for simulated cache results
+ *
+ * Each cache level and memory has a latency, paid on every lookup that
+ * reaches it, and a bandwidth, the bytes per cycle it can move to the level
+ * above. Adding up the latencies gives the time if nothing overlapped;
+ * dividing each level's traffic by its bandwidth gives the time that level
+ * alone needs. The estimate is the larger of the two: a run is either
+ * latency bound or limited by its busiest level. Stall cycles are the part
+ * of the estimate beyond one L1 hit per access, and AMAT the latency total
+ * per access.
+ *
+ * The model knows nothing about overlap between misses or about the core,
+ * so its numbers are only good for ranking candidates against each other.
+ */
+
+#ifndef COST_H
+#define COST_H
+
+#include <stdio.h>
+
+#define COST_MAX_CACHES 4      // L1 .. L4; memory comes after the last
+
+typedef struct cost_level {
+    double latency;    // cycles per lookup
+    double bandwidth;  // bytes per cycle to the level above (the core, for L1)
+} cost_level_t;
+
+typedef struct cost_model {
+    cost_level_t caches[COST_MAX_CACHES];
+    cost_level_t mem;
+} cost_model_t;
+
+/* What one level (or memory) was asked to do */
+typedef struct cost_usage {
+    unsigned long lookups;      // accesses that reached the level
+    unsigned long long bytes;   // bytes it moved to the level above, and took written back from it
+} cost_usage_t;
+
+typedef struct cost_estimate {
+    double amat;                // latency cycles per access
+    double latencyCycles;
+    double bandwidthCycles;     // of the busiest level
+    int bottleneck;             // that level: 0 .. numCaches - 1, numCaches for memory
+    double cycles;              // max(latencyCycles, bandwidthCycles)
+    double stallCycles;         // cycles beyond an L1 hit per access
+} cost_estimate_t;
+
+/* costInit - Defaults: L1 4 cycles 64 B/cycle, L2 14/32, L3 50/16, L4 80/16, memory 200/8 */
+void costInit(cost_model_t* model);
+
+/*
+ * costParse - Apply one "<level>=<latency>[:<bandwidth>]" setting, level
+ *     being L1 .. L4 or mem. Returns the cache level set (1 .. 4, 0 for
+ *     mem), or -1 if spec is malformed.
+ */
+int costParse(cost_model_t* model, const char* spec);
+
+/*
+ * costEstimate - Estimate the time of accesses served by numCaches cache
+ *     levels and memory, usage[numCaches] being memory's. extraCycles
+ *     (address translation, say) are added to the latency total.
+ */
+void costEstimate(const cost_model_t* model, const cost_usage_t usage[], int numCaches,
+                  unsigned long accesses, double extraCycles, cost_estimate_t* est);
+
+/* costPrint - costEstimate, printed as a table of levels and the totals */
+void costPrint(FILE* fp, const cost_model_t* model, const cost_usage_t usage[], int numCaches,
+               unsigned long accesses, double extraCycles);
+
+#endif /* COST_H */
@@ -1,4 +1,12 @@
+#define _DEFAULT_SOURCE
 #include "cachelab.h"
+#include "traceio.h"
+#include "cachesim.h"
+#include "stackdist.h"
+#include "report.h"
+#include "sample.h"
+#include "tlb.h"
+#include "cost.h"
 #include <unistd.h>
 #include <getopt.h>
 #include <stdlib.h>
@@ -7,99 +15,962 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
 
 #define ADDR_LEN 64
-typedef unsigned long long addr_t;
+#define BATCH_SIZE 4096 // trace records decoded per traceRead call
+#define RING_SIZE 65536 // accesses queued per worker thread, power of two
+#define MAX_THREADS 64
+#define INGEST_SLOTS 16 // decoded batches buffered between a live trace and the simulator
 
 char strMap[4][14] = {"hit", "miss", "miss eviction", ""};
 
-typedef struct cache_line {
+/*
+Miss-ratio curve mode: one pass over the trace measures LRU stack distances
+for every set count up to 2^maxSetBits, then prints what a separate csim run
+would report for each s = 0..maxSetBits and E = 1..maxAssoc.
+*/
+int runStackDist(trace_reader_t* reader, int maxSetBits, int maxAssoc, int blockBits) {
+    stackdist_t* sd = stackDistCreate(blockBits, maxSetBits, maxAssoc);
+    if (sd == NULL) {
+        printf("Unable to allocate stack distance state.\n");
+        return 1;
+    }
+
+    static trace_rec_t recs[BATCH_SIZE];
+    int numRecs;
+    while ((numRecs = traceRead(reader, recs, BATCH_SIZE)) > 0) {
+        for (int i = 0; i < numRecs; i += 1) {
+            if (stackDistAccess(sd, recs[i].addr) < 0) {
+                printf("Unable to allocate stack distance state.\n");
+                stackDistFree(sd);
+                return 1;
+            }
+            if (recs[i].op == 'M') {
+                stackDistRepeat(sd);
+            }
+        }
+    }
+    if (numRecs < 0) {
+        printf("The trace is truncated or corrupt.\n");
+        stackDistFree(sd);
+        return 1;
+    }
+
+    printf("%3s %5s %12s %12s %12s %12s %9s\n",
+           "s", "E", "bytes", "hits", "misses", "evictions", "missrate");
+    for (int s = 0; s <= maxSetBits; s += 1) {
+        for (int e = 1; e <= maxAssoc; e += 1) {
+            unsigned long hits, misses, evictions;
+            stackDistCounts(sd, s, e, &hits, &misses, &evictions);
+            unsigned long total = hits + misses;
+            printf("%3d %5d %12llu %12lu %12lu %12lu %9.6f\n",
+                   s, e, ((addr_t) e << s) << blockBits, hits, misses, evictions,
+                   total ? (double) misses / total : 0.0);
+        }
+    }
+    stackDistFree(sd);
+    return 0;
+}
+
+
+/*
+Parallel mode: LRU sets never interact, so set i is owned by worker
+i % numThreads, which simulates it as local set i / numThreads of a private
+cache. The main thread decodes the trace and routes each access to its
+owner's single-producer/single-consumer ring; head and tail are published
+once per batch rather than per access. Each worker counts its own hits,
+misses and evictions, which are summed after the join.
+*/
+typedef struct access {
     addr_t tag;
-    unsigned long timestamp;
-    bool isValid;
-} cache_line_t;
+    addr_t setI;     // set index within the worker's cache
+    int isModify;    // M: the store after the load always hits
+} access_t;
+
+typedef struct worker {
+    // Ring indexes grow without bound and are masked on use. tail is
+    // written by the main thread only, head by the worker only.
+    __attribute__((aligned(64))) unsigned long tail;
+    __attribute__((aligned(64))) unsigned long head;
+    __attribute__((aligned(64))) int done;   // no more accesses will be queued
+    access_t* ring;
+    cache_t cache;
+    unsigned long hits, misses, evictions;
+    pthread_t thread;
+} worker_t;
+
+
+static void* simWorker(void* arg) {
+    worker_t* w = (worker_t*) arg;
+    unsigned long head = w->head;
+
+    for (;;) {
+        unsigned long tail = __atomic_load_n(&w->tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            if (__atomic_load_n(&w->done, __ATOMIC_ACQUIRE) &&
+                head == __atomic_load_n(&w->tail, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        for (; head != tail; head += 1) {
+            const access_t* a = &w->ring[head & (RING_SIZE - 1)];
+            int result = load(&w->cache, a->setI, a->tag);
+            if (result == 0) {
+                w->hits += 1;
+            } else {
+                w->misses += 1;
+                w->evictions += (result == 2);
+            }
+            w->hits += a->isModify;
+        }
+        __atomic_store_n(&w->head, head, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+
+int runParallel(trace_reader_t* reader, int numThreads, int setBits, int associativity, int blockBits, policy_t policy,
+                unsigned long* hits, unsigned long* misses, unsigned long* evictions) {
+    int tagBits = ADDR_LEN - setBits - blockBits;
+    int tagShift = blockBits + setBits;
+    addr_t setMask = ~(0xffffffffffffffff << setBits);
+    addr_t tagMask = ~(0xffffffffffffffff << tagBits);
+    addr_t numSets = pow(2, setBits);
+
+    // Every worker needs at least one set
+    if ((addr_t) numThreads > numSets) {
+        numThreads = numSets;
+    }
+    worker_t* workers = NULL;
+    if (posix_memalign((void**) &workers, 64, numThreads * sizeof(worker_t)) != 0) {
+        printf("Unable to allocate workers.\n");
+        exit(1);
+    }
+    memset(workers, 0, numThreads * sizeof(worker_t));
+    for (int t = 0; t < numThreads; t += 1) {
+        worker_t* w = &workers[t];
+        w->ring = (access_t*) malloc(RING_SIZE * sizeof(access_t));
+        if (w->ring == NULL) {
+            printf("Unable to allocate worker queues.\n");
+            exit(1);
+        }
+        // Sets t, t + numThreads, ... up to numSets
+        if (initCache(&w->cache, (numSets - t + numThreads - 1) / numThreads, associativity, policy) < 0) {
+            printf("Unable to allocate cache.\n");
+            exit(1);
+        }
+        seedSets(&w->cache, t, numThreads);
+        if (pthread_create(&w->thread, NULL, simWorker, w) != 0) {
+            printf("Unable to start worker threads.\n");
+            exit(1);
+        }
+    }
+
+    // Main thread's private copy of each worker's tail
+    unsigned long tails[MAX_THREADS];
+    for (int t = 0; t < numThreads; t += 1) {
+        tails[t] = 0;
+    }
 
-typedef cache_line_t* cache_set_t;
-typedef cache_set_t* cache_t;
+    static trace_rec_t recs[BATCH_SIZE];
+    int numRecs;
+    while ((numRecs = traceRead(reader, recs, BATCH_SIZE)) > 0) {
+        for (int i = 0; i < numRecs; i += 1) {
+            addr_t addr = recs[i].addr;
+            addr_t setIndex = (addr >> blockBits) & setMask;
+            worker_t* w = &workers[setIndex % numThreads];
+            unsigned long* tail = &tails[setIndex % numThreads];
+
+            if (*tail - __atomic_load_n(&w->head, __ATOMIC_ACQUIRE) == RING_SIZE) {
+                // Full: hand over what is queued and wait for room
+                __atomic_store_n(&w->tail, *tail, __ATOMIC_RELEASE);
+                while (*tail - __atomic_load_n(&w->head, __ATOMIC_ACQUIRE) == RING_SIZE) {
+                    sched_yield();
+                }
+            }
+            access_t* a = &w->ring[*tail & (RING_SIZE - 1)];
+            a->tag = (addr >> tagShift) & tagMask;
+            a->setI = setIndex / numThreads;
+            a->isModify = (recs[i].op == 'M');
+            *tail += 1;
+        }
+        for (int t = 0; t < numThreads; t += 1) {
+            __atomic_store_n(&workers[t].tail, tails[t], __ATOMIC_RELEASE);
+        }
+    }
+    if (numRecs < 0) {
+        printf("The trace is truncated or corrupt.\n");
+        exit(1);
+    }
+
+    *hits = *misses = *evictions = 0;
+    for (int t = 0; t < numThreads; t += 1) {
+        __atomic_store_n(&workers[t].done, 1, __ATOMIC_RELEASE);
+    }
+    for (int t = 0; t < numThreads; t += 1) {
+        worker_t* w = &workers[t];
+        pthread_join(w->thread, NULL);
+        *hits += w->hits;
+        *misses += w->misses;
+        *evictions += w->evictions;
+        freeCache(&w->cache);
+        free(w->ring);
+    }
+    free(workers);
+    return 0;
+}
 
 
 /*
-In initCache, cache is a stack address. Deference this and malloc memory
-so that the 8B chunk in the stack points to the heap.
+Hierarchy mode: L1 is the -s/-E cache, and each -L adds the next level
+down. All levels share the block size and replacement policy. Lines are
+tracked by block number; a level's set and tag are its low setBits bits
+and the rest.
+
+Write-back + write-allocate: stores dirty the L1 line, and dirty lines
+are written to the next level (or memory) when they leave a level.
+Write-through + no-write-allocate: stores update the levels that hold
+the block, go straight to memory and never allocate.
+
+Inclusion decides what moves between levels on a miss:
+    nine   the block is filled into every level that missed
+    incl   as nine, and a lower level's victim is also invalidated in
+           the levels above it (a dirty upper copy is written back)
+    excl   the block lives in one level only: it moves up into L1 from
+           wherever it hit, and each level's victim drops to the next
+           level down (clean or dirty), the last level's to memory
+
+Hits and misses count demand lookups only. Writebacks into a lower level
+are not lookups, but they can evict there.
+
+An optional prefetcher (-P) watches the load half of each L1 demand access
+and brings predicted blocks into L1 the way a demand miss would, without
+counting hits or misses:
+    next    on an L1 miss, or the first use of a prefetched line, fetch
+            the next degree blocks (tagged next-line)
+    stride  a table indexed by pc (or by 4 KB page when the trace has no
+            pcs) learns the address stride of each stream, and once it has
+            repeated twice fetches degree steps of at least a block ahead
+    stream  L1 misses to adjacent blocks start a stream in that direction,
+            which then keeps up to degree blocks prefetched ahead of every
+            miss or prefetched hit that continues it
+A prefetched line only counts as ready latency demand accesses after it was
+issued. A demand hit before then still counts as an L1 hit, but is late.
 */
-void initCache(cache_t* cache, int s, int associativity) {
+#define MAX_LEVELS 4
+#define STRIDE_ENTRIES 64
+#define STREAM_ENTRIES 16
+#define POLLUTION_ENTRIES 4096  // recent prefetch victims, direct mapped
+#define STRIDE_PAGE_BITS 12
+#define PREFETCH_LATENCY 20
+
+typedef enum inclusion {
+    INCL_NINE,
+    INCL_INCLUSIVE,
+    INCL_EXCLUSIVE,
+    NUM_INCLUSIONS
+} inclusion_t;
+
+char* inclusionNames[NUM_INCLUSIONS] = {"nine", "incl", "excl"};
+
+typedef enum prefetcher {
+    PREFETCH_NONE,
+    PREFETCH_NEXT,
+    PREFETCH_STRIDE,
+    PREFETCH_STREAM,
+    NUM_PREFETCHERS
+} prefetcher_t;
+
+char* prefetcherNames[NUM_PREFETCHERS] = {"none", "next", "stride", "stream"};
+int prefetchDegrees[NUM_PREFETCHERS] = {0, 1, 2, 4}; // defaults
+
+typedef struct strideEntry {
+    addr_t key;         // pc, or page with the top bit set
+    addr_t lastAddr;
+    long long stride;
+    int confidence;     // times stride repeated, saturating at 3
+    bool valid;
+} stride_entry_t;
+
+typedef struct streamEntry {
+    addr_t lastBlock;
+    addr_t frontier;    // furthest block prefetched
+    int dir;            // +1 or -1, 0 while untrained
+    unsigned long lastUse;
+    bool valid;
+} stream_entry_t;
+
+typedef struct prefetchState {
+    prefetcher_t kind;
+    int degree;
+    int latency;
+    unsigned long now;            // demand accesses so far
+    bool active;                  // the current fill is a prefetch
+    bool usedPrefetch;            // the last access was the first use of a prefetched line
+    bool* prefetched;             // per L1 line: filled by a prefetch and not used yet
+    unsigned long* readyTime;     // per L1 line: when its prefetch completes
+    addr_t victims[POLLUTION_ENTRIES]; // block + 1 evicted by a prefetch, 0 if none
+    stride_entry_t strides[STRIDE_ENTRIES];
+    stream_entry_t streams[STREAM_ENTRIES];
+    unsigned long issued, useful, late, unused, polluting;
+} prefetch_t;
+
+typedef struct level {
+    cache_t cache;
+    int setBits;
+    addr_t setMask;
+    unsigned long hits, misses, evictions;
+    unsigned long writebacks;     // dirty lines sent to the next level or memory
+    unsigned long invalidations;  // lines dropped to keep a lower level inclusive
+} level_t;
+
+typedef struct hierarchy {
+    level_t levels[MAX_LEVELS];
+    int numLevels;
+    bool writeBack;               // else write-through + no-write-allocate
+    inclusion_t inclusion;
+    unsigned long memReads;       // blocks fetched from memory
+    unsigned long memWrites;      // writebacks (blocks) or stores written through
+    unsigned long long coreBytes; // loaded and stored by the trace
+    int blockBits;
+    prefetch_t prefetch;
+} hierarchy_t;
+
+
+static inline addr_t levelSet(const level_t* lvl, addr_t block) {
+    return block & lvl->setMask;
+}
+
+
+static inline addr_t levelTag(const level_t* lvl, addr_t block) {
+    return block >> lvl->setBits;
+}
+
+
+/* Returns the way holding block in level i, or -1 */
+static int levelFind(hierarchy_t* h, int i, addr_t block) {
+    level_t* lvl = &h->levels[i];
+    return findLine(&lvl->cache, levelSet(lvl, block), levelTag(lvl, block));
+}
+
+
+static void installBlock(hierarchy_t* h, int i, addr_t block, bool dirty);
+
+
+/* A dirty block written back out of level i - 1 arrives at level i */
+static void writeBackBlock(hierarchy_t* h, int i, addr_t block) {
+    if (i == h->numLevels) {
+        h->memWrites += 1;
+        return;
+    }
+    int way = levelFind(h, i, block);
+    if (way != -1) {
+        level_t* lvl = &h->levels[i];
+        lvl->cache.isDirty[levelSet(lvl, block) * lvl->cache.associativity + way] = true;
+    } else {
+        installBlock(h, i, block, true);
+    }
+}
+
+
+/* Puts block into level i and sends whatever it evicts where it belongs */
+static void installBlock(hierarchy_t* h, int i, addr_t block, bool dirty) {
+    level_t* lvl = &h->levels[i];
+    addr_t setI = levelSet(lvl, block);
+    addr_t victimTag;
+    bool victimDirty;
 
-    *cache = (cache_set_t*) malloc(sizeof(cache_set_t) * s);
-    for (int i = 0; i < s; i += 1) {
+    prefetch_t* pf = &h->prefetch;
+    int way;
+
+    int result = insertLine(&lvl->cache, setI, levelTag(lvl, block), dirty, &victimTag, &victimDirty, &way);
+    addr_t victim = (lvl->setBits < ADDR_LEN ? victimTag << lvl->setBits : 0) | setI;
+    if (i == 0 && pf->kind != PREFETCH_NONE) {
+        addr_t line = setI * lvl->cache.associativity + way;
+        if (result == 2) {
+            pf->unused += pf->prefetched[line];
+            if (pf->active) {
+                pf->victims[victim % POLLUTION_ENTRIES] = victim + 1;
+            }
+        }
+        pf->prefetched[line] = pf->active;
+        pf->readyTime[line] = pf->now + pf->latency;
+    }
+    if (result != 2) {
+        return;
+    }
+    lvl->evictions += 1;
 
-        (*cache)[i] = (cache_line_t*) malloc(sizeof(cache_line_t) * associativity);
-        for (int j = 0; j < associativity; j += 1) {
-            (*cache)[i][j].tag = 0;
-            (*cache)[i][j].isValid = false;
-            (*cache)[i][j].timestamp = 0;
+    if (h->inclusion == INCL_INCLUSIVE) {
+        for (int j = 0; j < i; j += 1) {
+            int upperWay = levelFind(h, j, victim);
+            if (upperWay != -1) {
+                level_t* upper = &h->levels[j];
+                addr_t upperSet = levelSet(upper, victim);
+                addr_t line = upperSet * upper->cache.associativity + upperWay;
+                victimDirty |= upper->cache.isDirty[line];
+                if (j == 0 && pf->kind != PREFETCH_NONE) {
+                    pf->unused += pf->prefetched[line];
+                    pf->prefetched[line] = false;
+                }
+                invalidateLine(&upper->cache, upperSet, upperWay);
+                upper->invalidations += 1;
+            }
         }
     }
+    if (h->inclusion == INCL_EXCLUSIVE && i + 1 < h->numLevels) {
+        lvl->writebacks += victimDirty;
+        installBlock(h, i + 1, victim, victimDirty);
+    } else if (victimDirty) {
+        lvl->writebacks += 1;
+        writeBackBlock(h, i + 1, victim);
+    }
+}
+
+
+/* Books a demand hit on L1 way against the prefetcher */
+static void prefetchUse(hierarchy_t* h, addr_t block, int way) {
+    prefetch_t* pf = &h->prefetch;
+    level_t* l1 = &h->levels[0];
+    addr_t line = levelSet(l1, block) * l1->cache.associativity + way;
+
+    if (pf->kind != PREFETCH_NONE && pf->prefetched[line]) {
+        pf->prefetched[line] = false;
+        pf->useful += 1;
+        pf->late += (pf->readyTime[line] > pf->now);
+        pf->usedPrefetch = true;
+    }
+}
+
+
+/* Books a demand miss in L1 against the prefetcher */
+static void prefetchMiss(hierarchy_t* h, addr_t block) {
+    prefetch_t* pf = &h->prefetch;
+
+    if (pf->kind != PREFETCH_NONE && pf->victims[block % POLLUTION_ENTRIES] == block + 1) {
+        pf->victims[block % POLLUTION_ENTRIES] = 0;
+        pf->polluting += 1;
+    }
 }
 
 
 /*
-Results in either hit (pull/push data from data cache),
-miss (data not in cache, pull from memory and replace !isValid line / push to
-!isValid line), or miss + evict (data not in cache and replace LRU line)
+Brings block, found in level k (k == numLevels for memory, way is its way
+there), into L1 and, unless levels are exclusive, every level between.
 */
-int load(cache_t* cache, addr_t setI, addr_t tag, int associativity, unsigned long timestamp) {
-    // Iterate through set, see if line with isValid and matching tag 
-    for (int j = 0; j < associativity; j += 1) {
-        if ((*cache)[setI][j].isValid && (*cache)[setI][j].tag == tag) {
-            (*cache)[setI][j].timestamp = timestamp;
-            return 0; // hit
+static void fillL1(hierarchy_t* h, addr_t block, int k, int way) {
+    if (k == h->numLevels) {
+        h->memReads += 1;
+    }
+    if (k > 0) {
+        if (h->inclusion == INCL_EXCLUSIVE) {
+            bool dirty = false;
+            if (k < h->numLevels) {
+                level_t* lvl = &h->levels[k];
+                addr_t setI = levelSet(lvl, block);
+                dirty = lvl->cache.isDirty[setI * lvl->cache.associativity + way];
+                invalidateLine(&lvl->cache, setI, way);
+            }
+            installBlock(h, 0, block, dirty);
+        } else {
+            // Lowest level first, so inclusive back-invalidations never hit the new block
+            for (int i = k - 1; i >= 0; i -= 1) {
+                installBlock(h, i, block, false);
+            }
+        }
+    }
+}
+
+
+/* Returns the result of the access in L1: 0 hit, 1 miss, 2 miss eviction */
+static int hierarchyAccess(hierarchy_t* h, addr_t block, bool isWrite) {
+    int k;
+    unsigned long l1Evictions = h->levels[0].evictions;
+
+    h->prefetch.now += 1;
+    h->prefetch.usedPrefetch = false;
+    if (isWrite && !h->writeBack) {
+        // Update every copy, write to memory, allocate nowhere
+        int result = 1;
+        for (k = 0; k < h->numLevels; k += 1) {
+            level_t* lvl = &h->levels[k];
+            int way = levelFind(h, k, block);
+            if (way != -1) {
+                policyHit(&lvl->cache, levelSet(lvl, block), way);
+                lvl->hits += 1;
+                if (k == 0) {
+                    prefetchUse(h, block, way);
+                    result = 0;
+                }
+            } else {
+                lvl->misses += 1;
+                if (k == 0) {
+                    prefetchMiss(h, block);
+                }
+            }
+        }
+        h->memWrites += 1;
+        return result;
+    }
+
+    // Look down the hierarchy for the first level holding the block
+    int way = -1;
+    for (k = 0; k < h->numLevels; k += 1) {
+        level_t* lvl = &h->levels[k];
+        way = levelFind(h, k, block);
+        if (way != -1) {
+            lvl->hits += 1;
+            policyHit(&lvl->cache, levelSet(lvl, block), way);
+            break;
+        }
+        lvl->misses += 1;
+    }
+    if (k == 0) {
+        prefetchUse(h, block, way);
+    } else {
+        prefetchMiss(h, block);
+    }
+    fillL1(h, block, k, way);
+    if (isWrite) {
+        level_t* l1 = &h->levels[0];
+        l1->cache.isDirty[levelSet(l1, block) * l1->cache.associativity + levelFind(h, 0, block)] = true;
+    }
+    if (k == 0) {
+        return 0;
+    }
+    return (h->levels[0].evictions != l1Evictions) ? 2 : 1;
+}
+
+
+/* Fetches block into L1 unless it is already there */
+static void issuePrefetch(hierarchy_t* h, addr_t block) {
+    prefetch_t* pf = &h->prefetch;
+    int k, way = -1;
+
+    if (levelFind(h, 0, block) != -1) {
+        return;
+    }
+    for (k = 1; k < h->numLevels; k += 1) {
+        if ((way = levelFind(h, k, block)) != -1) {
+            break;
         }
     }
-    // Miss: either find a non-valid line, or if all lines valid, the LRU line
-    unsigned long lru = 0xFFFFFFFF;
-    int lruIndex;
-    for (int j = 0; j < associativity; j += 1) {
+    pf->active = true;
+    fillL1(h, block, k, way);
+    pf->active = false;
+    pf->issued += 1;
+}
+
+
+/* Runs up to degree blocks ahead of a stream that just reached block */
+static void advanceStream(hierarchy_t* h, stream_entry_t* st, addr_t block) {
+    prefetch_t* pf = &h->prefetch;
+    addr_t target = block + (addr_t) (long long) (st->dir * pf->degree);
+    addr_t next = ((long long) (st->frontier - block) * st->dir > 0) ? st->frontier : block;
+
+    st->lastBlock = block;
+    st->lastUse = pf->now;
+    while (next != target) {
+        next += (addr_t) (long long) st->dir;
+        issuePrefetch(h, next);
+    }
+    st->frontier = target;
+}
+
+
+/*
+Trains the prefetcher on the load half of a demand access to addr (made
+by the instruction at pc) that missed L1 if l1Miss, and issues whatever it
+predicts.
+*/
+static void prefetchAccess(hierarchy_t* h, addr_t addr, addr_t pc, bool l1Miss) {
+    prefetch_t* pf = &h->prefetch;
+    addr_t block = addr >> h->blockBits;
+    bool trigger = l1Miss || pf->usedPrefetch;
 
-        // If an instance of !isValid, "load" into that line
-        if (!((*cache)[setI][j].isValid)) {
-            (*cache)[setI][j].isValid = true;
-            (*cache)[setI][j].tag = tag;
-            (*cache)[setI][j].timestamp = timestamp;
-            return 1; // miss
+    switch (pf->kind) {
+        case PREFETCH_NEXT:
+            if (trigger) {
+                for (int d = 1; d <= pf->degree; d += 1) {
+                    issuePrefetch(h, block + d);
+                }
+            }
+            break;
+        case PREFETCH_STRIDE: {
+            addr_t key = pc ? pc : (addr >> STRIDE_PAGE_BITS) | (1ULL << 63);
+            stride_entry_t* e = &pf->strides[(key * 0x9E3779B97F4A7C15ULL) >> 58]; // 64 entries
+            if (!e->valid || e->key != key) {
+                *e = (stride_entry_t) {.key = key, .lastAddr = addr, .valid = true};
+                break;
+            }
+            long long stride = (long long) (addr - e->lastAddr);
+            if (stride == 0) {
+                break;
+            }
+            e->lastAddr = addr;
+            if (stride == e->stride) {
+                e->confidence += (e->confidence < 3);
+            } else {
+                e->stride = stride;
+                e->confidence = 0;
+            }
+            if (e->confidence >= 2) {
+                // Step at least a block so small strides still run ahead
+                long long blockSize = 1LL << h->blockBits;
+                long long step = (stride > -blockSize && stride < blockSize) ?
+                                 (stride > 0 ? blockSize : -blockSize) : stride;
+                for (int d = 1; d <= pf->degree; d += 1) {
+                    issuePrefetch(h, (addr + (addr_t) (step * d)) >> h->blockBits);
+                }
+            }
+            break;
         }
-        // Finding the line with lowest lru in parallel
-        if ((*cache)[setI][j].timestamp < lru) {
-            lru = (*cache)[setI][j].timestamp;
-            lruIndex = j;
+        case PREFETCH_STREAM: {
+            if (!trigger) {
+                break;
+            }
+            stream_entry_t* oldest = &pf->streams[0];
+            for (int i = 0; i < STREAM_ENTRIES; i += 1) {
+                stream_entry_t* st = &pf->streams[i];
+                if (!st->valid) {
+                    oldest = st;
+                    continue;
+                }
+                long long ahead = (long long) (block - st->lastBlock) * st->dir;
+                long long reach = (long long) (st->frontier - st->lastBlock) * st->dir;
+                if (st->dir != 0 && ahead >= 1 && ahead <= reach + 1) {
+                    advanceStream(h, st, block);
+                    return;
+                }
+                if (st->dir == 0 && (block == st->lastBlock + 1 || block + 1 == st->lastBlock)) {
+                    st->dir = (block == st->lastBlock + 1) ? 1 : -1;
+                    st->frontier = block;
+                    advanceStream(h, st, block);
+                    return;
+                }
+                if (oldest->valid && st->lastUse < oldest->lastUse) {
+                    oldest = st;
+                }
+            }
+            *oldest = (stream_entry_t) {.lastBlock = block, .frontier = block, .lastUse = pf->now, .valid = true};
+            break;
         }
+        default:
+            break;
     }
-    // goes to this line if all isValid
-    (*cache)[setI][lruIndex].timestamp = timestamp; // representing an evict
-    (*cache)[setI][lruIndex].tag = tag;
-    return 2; // miss eviction
 }
 
 
-void freeCache(cache_t* cache, int s) {
-    for (int i = 0; i < s; i += 1) {
-        free((*cache)[i]);
+int runHierarchy(trace_reader_t* reader, hierarchy_t* h, int blockBits, policy_t policy, bool enableVerbose,
+                 tlb_t* tlb, unsigned long* hits, unsigned long* misses, unsigned long* evictions) {
+    static trace_rec_t recs[BATCH_SIZE];
+    int numRecs;
+
+    for (int i = 0; i < h->numLevels; i += 1) {
+        level_t* lvl = &h->levels[i];
+        if (initCache(&lvl->cache, (addr_t) 1 << lvl->setBits, lvl->cache.associativity, policy) < 0) {
+            printf("Unable to allocate cache.\n");
+            exit(1);
+        }
+        lvl->setMask = ~(0xffffffffffffffff << lvl->setBits);
+    }
+    h->blockBits = blockBits;
+    prefetch_t* pf = &h->prefetch;
+    if (pf->kind != PREFETCH_NONE) {
+        addr_t numLines = h->levels[0].cache.numSets * h->levels[0].cache.associativity;
+        pf->prefetched = (bool*) calloc(numLines, sizeof(bool));
+        pf->readyTime = (unsigned long*) calloc(numLines, sizeof(unsigned long));
+        if (!pf->prefetched || !pf->readyTime) {
+            printf("Unable to allocate prefetcher state.\n");
+            exit(1);
+        }
+    }
+
+    while ((numRecs = traceRead(reader, recs, BATCH_SIZE)) > 0) {
+        for (int i = 0; i < numRecs; i += 1) {
+            char cmd = recs[i].op;
+            addr_t block = recs[i].addr >> blockBits;
+            int result1, result2 = 3;
+
+            if (tlb != NULL) {
+                tlbAccess(tlb, recs[i].addr);
+            }
+            h->coreBytes += recs[i].size * (1 + (cmd == 'M'));
+            result1 = hierarchyAccess(h, block, cmd == 'S');
+            if (pf->kind != PREFETCH_NONE) {
+                prefetchAccess(h, recs[i].addr, recs[i].pc, result1 != 0);
+            }
+            if (cmd == 'M') {
+                result2 = hierarchyAccess(h, block, true);
+            }
+            if (enableVerbose) {
+                printf("%c %llx,%d %s %s\n", cmd, recs[i].addr, recs[i].size, strMap[result1], strMap[result2]);
+            }
+        }
     }
-    free(*cache);
+    if (numRecs < 0) {
+        printf("The trace is truncated or corrupt.\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < h->numLevels; i += 1) {
+        level_t* lvl = &h->levels[i];
+        printf("L%d: s=%d E=%d hits:%lu misses:%lu evictions:%lu writebacks:%lu invalidations:%lu\n",
+               i + 1, lvl->setBits, lvl->cache.associativity, lvl->hits, lvl->misses,
+               lvl->evictions, lvl->writebacks, lvl->invalidations);
+        freeCache(&lvl->cache);
+    }
+    printf("memory: reads:%lu writes:%lu traffic:%llu bytes\n", h->memReads, h->memWrites,
+           ((addr_t) h->memReads + h->memWrites) << blockBits);
+    if (pf->kind != PREFETCH_NONE) {
+        printf("prefetch: %s degree=%d issued:%lu useful:%lu late:%lu unused:%lu polluting:%lu\n",
+               prefetcherNames[pf->kind], pf->degree, pf->issued, pf->useful, pf->late,
+               pf->unused, pf->polluting);
+        free(pf->prefetched);
+        free(pf->readyTime);
+    }
+    *hits = h->levels[0].hits;
+    *misses = h->levels[0].misses;
+    *evictions = h->levels[0].evictions;
+    return 0;
+}
+
+
+/*
+Live traces (stdin, pipes, sockets): a decoder thread reads the trace into
+a ring of INGEST_SLOTS batches, which the simulator works through. When the
+ring is full the decoder waits, stops reading, and the producer blocks on
+its next write once the pipe or socket buffer fills, so a fast producer is
+held to the simulator's pace rather than queued in memory. The slot being
+simulated stays owned by the simulator until it asks for the next batch.
+*/
+typedef struct ingest {
+    trace_reader_t* reader;
+    trace_rec_t (*slots)[BATCH_SIZE];
+    int counts[INGEST_SLOTS];
+    unsigned long head;       // batches handed back by the simulator
+    unsigned long tail;       // batches decoded
+    bool holding;             // the simulator has slot head
+    bool done;                // the trace has ended
+    bool failed;              // the trace is truncated or corrupt
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+} ingest_t;
+
+
+static void* ingestDecoder(void* arg) {
+    ingest_t* in = (ingest_t*) arg;
+
+    for (;;) {
+        pthread_mutex_lock(&in->lock);
+        while (in->tail - in->head == INGEST_SLOTS) {
+            pthread_cond_wait(&in->changed, &in->lock);
+        }
+        unsigned long slot = in->tail % INGEST_SLOTS;
+        pthread_mutex_unlock(&in->lock);
+
+        int n = traceRead(in->reader, in->slots[slot], BATCH_SIZE);
+
+        pthread_mutex_lock(&in->lock);
+        if (n > 0) {
+            in->counts[slot] = n;
+            in->tail += 1;
+        } else {
+            in->done = true;
+            in->failed = (n < 0);
+        }
+        pthread_cond_broadcast(&in->changed);
+        pthread_mutex_unlock(&in->lock);
+        if (n <= 0) {
+            return NULL;
+        }
+    }
+}
+
+
+int ingestStart(ingest_t* in, trace_reader_t* reader) {
+    memset(in, 0, sizeof(ingest_t));
+    in->reader = reader;
+    in->slots = malloc(INGEST_SLOTS * sizeof(*in->slots));
+    if (in->slots == NULL) {
+        return -1;
+    }
+    pthread_mutex_init(&in->lock, NULL);
+    pthread_cond_init(&in->changed, NULL);
+    if (pthread_create(&in->thread, NULL, ingestDecoder, in) != 0) {
+        free(in->slots);
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+Returns the previous batch to the decoder and waits for the next; 0 at the
+end, -1 if the trace turned out to be damaged
+*/
+int ingestNext(ingest_t* in, trace_rec_t** recs) {
+    pthread_mutex_lock(&in->lock);
+    if (in->holding) {
+        in->head += 1;
+        in->holding = false;
+        pthread_cond_broadcast(&in->changed);
+    }
+    while (in->head == in->tail && !in->done) {
+        pthread_cond_wait(&in->changed, &in->lock);
+    }
+    int n = in->failed ? -1 : 0;
+    if (in->head != in->tail) {
+        *recs = in->slots[in->head % INGEST_SLOTS];
+        n = in->counts[in->head % INGEST_SLOTS];
+        in->holding = true;
+    }
+    pthread_mutex_unlock(&in->lock);
+    return n;
+}
+
+
+void ingestStop(ingest_t* in) {
+    pthread_join(in->thread, NULL);
+    pthread_mutex_destroy(&in->lock);
+    pthread_cond_destroy(&in->changed);
+    free(in->slots);
+}
+
+
+/* Interval statistics: the misses and evictions of the accesses since the last line */
+void printInterval(cachesim_t* sim, unsigned long* lastAccesses, unsigned long* lastMisses,
+                   unsigned long* lastEvictions) {
+    unsigned long accesses = sim->hits + sim->misses;
+    unsigned long n = accesses - *lastAccesses;
+    unsigned long misses = sim->misses - *lastMisses;
+
+    printf("interval %lu-%lu: misses:%lu evictions:%lu misses/1M:%.0f\n", *lastAccesses, accesses,
+           misses, sim->evictions - *lastEvictions, n ? 1e6 * misses / n : 0.0);
+    fflush(stdout);
+    *lastAccesses = accesses;
+    *lastMisses = sim->misses;
+    *lastEvictions = sim->evictions;
+}
+
+
+/*
+Sampling modes: feed every record to the sampler, then print its estimates
+with their 95% confidence intervals, and the usual summary line with the
+estimates rounded.
+*/
+int runSampling(trace_reader_t* reader, sampler_t* sampler) {
+    static trace_rec_t recs[BATCH_SIZE];
+    int numRecs;
+
+    while ((numRecs = traceRead(reader, recs, BATCH_SIZE)) > 0) {
+        for (int i = 0; i < numRecs; i += 1) {
+            samplerAccess(sampler, recs[i].addr, recs[i].op == 'M');
+        }
+    }
+    if (numRecs < 0) {
+        printf("The trace is truncated or corrupt.\n");
+        return 1;
+    }
+
+    estimate_t est[3];
+    char* names[3] = {"hits", "misses", "evictions"};
+    unsigned long samples = samplerEstimate(sampler, &est[0], &est[1], &est[2]);
+    printf("sampled: %lu samples, %.2f%% of accesses simulated\n", samples, 100.0 * samplerFraction(sampler));
+    if (samples < 2) {
+        printf("Too few samples for confidence intervals.\n");
+    }
+    for (int i = 0; i < 3; i += 1) {
+        printf("%-10s %14.0f +- %.0f (%.2f%%)\n", names[i], est[i].value, est[i].halfWidth,
+               est[i].value > 0 ? 100.0 * est[i].halfWidth / est[i].value : 0.0);
+    }
+    printSummary(llround(est[0].value), llround(est[1].value), llround(est[2].value));
+    return 0;
+}
+
+
+/*
+Cost mode: what each level was asked to do, for the cost model. A cache
+below L1 serves the misses of the level above it and takes its dirty
+victims; memory serves the blocks read from it and takes the blocks (or
+stores) written to it. L1 serves the bytes the trace loads and stores.
+*/
+void hierarchyUsage(const hierarchy_t* h, cost_usage_t usage[]) {
+    for (int i = 0; i < h->numLevels; i += 1) {
+        const level_t* lvl = &h->levels[i];
+        usage[i].lookups = lvl->hits + lvl->misses;
+        if (i == 0) {
+            usage[i].bytes = h->coreBytes;
+        } else {
+            const level_t* upper = &h->levels[i - 1];
+            usage[i].bytes = (unsigned long long) (upper->misses + upper->writebacks) << h->blockBits;
+        }
+    }
+    usage[h->numLevels].lookups = h->memReads;
+    usage[h->numLevels].bytes = (unsigned long long) (h->memReads + h->memWrites) << h->blockBits;
 }
 
 
 void printHelp(char* argv[]) {
-    printf("Usage: %s [-hv] -s <num> -E <num> -b <num> -t <file>\n\n", argv[0]);
+    printf("Usage: %s [-hvm] [-j <num>] [-p <policy>] [-L <s>:<E>]... [-W <wb|wt>] [-I <incl>] [-P <pf>]\n"
+           "          [-a] [-A <name>:<start>-<end>]... [-S <num>[:<seed>]] [-T <skip>:<warm>:<measure>]\n"
+           "          [-i <num>] [-V <4k|2m>] [-c] [-C <level>=<latency>[:<bandwidth>]]...\n"
+           "          -s <num> -E <num> -b <num> -t <file>\n\n", argv[0]);
     printf("Options:\n");
     printf("-h         Print this help message.\n");
     printf("-v         Optional verbose flag.\n");
+    printf("-m         Miss-ratio curve: report every s' <= s and E' <= E in one pass.\n");
+    printf("-j <num>   Simulate with <num> threads, each owning a share of the sets.\n");
+    printf("-p <name>  Replacement policy: lru (default), fifo, random, plru,\n");
+    printf("           srrip, brrip or lfu. plru needs E to be a power of two.\n");
+    printf("-L <s>:<E> Add a lower cache level with 2^s sets of E lines (up to %d levels).\n", MAX_LEVELS);
+    printf("-W <name>  Write policy: wb (write-back, write-allocate; default)\n");
+    printf("           or wt (write-through, no-write-allocate).\n");
+    printf("-I <name>  Inclusion between levels: nine (default), incl or excl.\n");
+    printf("-P <name>[:<degree>[:<latency>]]\n");
+    printf("           L1 prefetcher: next, stride or stream, fetching <degree> blocks\n");
+    printf("           ahead that are ready <latency> accesses later (default %d).\n", PREFETCH_LATENCY);
+    printf("-a         Report hits, misses and evictions per set and per 4 KB page, with\n");
+    printf("           misses split into compulsory, capacity and conflict.\n");
+    printf("-A <range> Also report the range <name>:<start>-<end> (hex, implies -a).\n");
+    printf("-S <num>[:<seed>]\n");
+    printf("           Set sampling: simulate <num> randomly chosen sets and estimate\n");
+    printf("           the totals, with 95%% confidence intervals.\n");
+    printf("-T <skip>:<warm>:<measure>\n");
+    printf("           Time sampling: repeatedly skip <skip> records, simulate <warm>\n");
+    printf("           to warm up and count <measure>, and estimate the totals.\n");
+    printf("-i <num>   Print the misses of every <num> accesses as they are simulated.\n");
+    printf("-V <page>  Translate through a dTLB, STLB and page-walk cache first, with\n");
+    printf("           4k or 2m pages, and report their hits and estimated cycles.\n");
+    printf("-c         Estimate cycles: AMAT, stalls and bytes moved per level.\n");
+    printf("-C <level>=<latency>[:<bandwidth>]\n");
+    printf("           Set the latency (cycles) and bandwidth (bytes/cycle) of L1..L4\n");
+    printf("           or mem for -c (implies -c). L2 and below need their -L levels.\n");
     printf("-s <num>   Number of set index bits.\n");
     printf("-E <num>   Number of lines per set. \n");
     printf("-b <num>   Number of block offset bits.\n");
-    printf("-t <file>  Trace file.\n\n");
+    printf("-t <file>  Trace file ('-' reads stdin, unix:<path> listens on a socket).\n\n");
     printf("Examples:\n");
     printf("linux>  %s -s 4 -E 1 -b 4 -t traces/yi.trace\n", argv[0]);
     printf("linux>  %s -v -s 8 -E 2 -b 4 -t traces/yi.trace\n", argv[0]);
+    printf("linux>  %s -m -s 8 -E 16 -b 5 -t traces/long.trace\n", argv[0]);
+    printf("linux>  %s -j 4 -s 10 -E 8 -b 6 -t big.ctr\n", argv[0]);
+    printf("linux>  %s -p srrip -s 6 -E 16 -b 6 -t traces/long.trace\n", argv[0]);
+    printf("linux>  %s -s 6 -E 8 -L 9:8 -L 12:16 -I incl -b 6 -t traces/long.trace\n", argv[0]);
+    printf("linux>  %s -P stream:4 -s 5 -E 1 -b 5 -t traces/trans.trace\n", argv[0]);
+    printf("linux>  %s -A A:602100-606100 -A B:642100-646100 -s 5 -E 1 -b 5 -t trace.f0\n", argv[0]);
+    printf("linux>  %s -S 64 -s 10 -E 4 -b 6 -t big.ctr\n", argv[0]);
+    printf("linux>  %s -T 90000:9000:1000 -s 10 -E 4 -b 6 -t big.ctr\n", argv[0]);
+    printf("linux>  valgrind --tool=lackey --trace-mem=yes --log-fd=1 ./prog | %s -s 4 -E 1 -b 4 -t -\n", argv[0]);
+    printf("linux>  %s -V 2m -s 6 -E 8 -b 6 -t traces/long.trace\n", argv[0]);
+    printf("linux>  %s -C L2=12:32 -C mem=250 -s 6 -E 8 -L 10:16 -b 6 -t traces/long.trace\n", argv[0]);
+    printf("linux>  %s -i 1000000 -s 10 -E 8 -b 6 -t unix:/tmp/csim.sock\n", argv[0]);
 }
 
 
@@ -109,16 +980,34 @@ int main(int argc, char* argv[]) {
     unsigned long evictions = 0;
     
     bool enableVerbose = false;
+    bool curveMode = false;
+    int numThreads = 1;
+    policy_t policy = POLICY_LRU;
+    static hierarchy_t hierarchy = {.numLevels = 1, .writeBack = true, .inclusion = INCL_NINE,
+                                    .prefetch = {.kind = PREFETCH_NONE, .latency = PREFETCH_LATENCY}};
+    bool hierarchyMode = false;
+    bool reportMode = false;
+    char* rangeSpecs[REPORT_MAX_RANGES];
+    int numRanges = 0;
     int setBits = 0;
     int blockBits = 0;
     int associativity = 0;
     int tagBits;
-    char* tracefile;
+    char* tracefile = NULL;
+    unsigned long sampleSets = 0;
+    unsigned long sampleSeed = 1;
+    unsigned long timeSkip = 0, timeWarmup = 0, timeMeasure = 0;
+    unsigned long interval = 0;
+    int pageSize = NUM_PAGE_SIZES;   // no TLB
+    bool costMode = false;
+    int maxCostLevel = 0;   // deepest cache level a -C sets
+    cost_model_t costModel;
+    costInit(&costModel);
 
     // By placing a colon as the first character of the options string,
     // getopt() returns ':' instead of '?' when no argument is given
     int opt;
-    while ((opt = getopt(argc, argv, ":hvs:E:b:t:")) != -1) {
+    while ((opt = getopt(argc, argv, ":hvmaA:j:p:L:W:I:P:S:T:i:V:cC:s:E:b:t:")) != -1) {
         switch(opt) {
             case 'h':
                 printHelp(argv);
@@ -126,6 +1015,150 @@ int main(int argc, char* argv[]) {
             case 'v':
                 enableVerbose = true;
                 break;
+            case 'm':
+                curveMode = true;
+                break;
+            case 'a':
+                reportMode = true;
+                break;
+            case 'A':
+                if (numRanges == REPORT_MAX_RANGES) {
+                    printf("At most %d address ranges.\n", REPORT_MAX_RANGES);
+                    return 1;
+                }
+                rangeSpecs[numRanges++] = optarg;
+                reportMode = true;
+                break;
+            case 'j':
+                numThreads = atoi(optarg);
+                if (numThreads < 1 || numThreads > MAX_THREADS) {
+                    printf("j must be between 1 and %d.\n", MAX_THREADS);
+                    return 1;
+                }
+                break;
+            case 'p':
+                for (policy = 0; policy < NUM_POLICIES; policy += 1) {
+                    if (strcmp(optarg, policyNames[policy]) == 0) {
+                        break;
+                    }
+                }
+                if (policy == NUM_POLICIES) {
+                    printf("Unknown replacement policy %s.\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'L': {
+                int lowerSetBits, lowerAssoc;
+                if (sscanf(optarg, "%d:%d", &lowerSetBits, &lowerAssoc) != 2 ||
+                    lowerSetBits < 0 || lowerSetBits > 32 || lowerAssoc < 1) {
+                    printf("-L takes <s>:<E> with s between 0 and 32 and E at least 1.\n");
+                    return 1;
+                }
+                if (hierarchy.numLevels == MAX_LEVELS) {
+                    printf("At most %d cache levels.\n", MAX_LEVELS);
+                    return 1;
+                }
+                hierarchy.levels[hierarchy.numLevels].setBits = lowerSetBits;
+                hierarchy.levels[hierarchy.numLevels].cache.associativity = lowerAssoc;
+                hierarchy.numLevels += 1;
+                hierarchyMode = true;
+                break;
+            }
+            case 'W':
+                if (strcmp(optarg, "wb") != 0 && strcmp(optarg, "wt") != 0) {
+                    printf("Unknown write policy %s.\n", optarg);
+                    return 1;
+                }
+                hierarchy.writeBack = (strcmp(optarg, "wb") == 0);
+                hierarchyMode = true;
+                break;
+            case 'I': {
+                int incl;
+                for (incl = 0; incl < NUM_INCLUSIONS; incl += 1) {
+                    if (strcmp(optarg, inclusionNames[incl]) == 0) {
+                        break;
+                    }
+                }
+                if (incl == NUM_INCLUSIONS) {
+                    printf("Unknown inclusion policy %s.\n", optarg);
+                    return 1;
+                }
+                hierarchy.inclusion = incl;
+                hierarchyMode = true;
+                break;
+            }
+            case 'P': {
+                char name[16];
+                prefetch_t* pf = &hierarchy.prefetch;
+                pf->degree = -1;
+                if (sscanf(optarg, "%15[a-z]:%d:%d", name, &pf->degree, &pf->latency) < 1) {
+                    name[0] = '\0';
+                }
+                for (pf->kind = 0; pf->kind < NUM_PREFETCHERS; pf->kind += 1) {
+                    if (strcmp(name, prefetcherNames[pf->kind]) == 0) {
+                        break;
+                    }
+                }
+                if (pf->kind == NUM_PREFETCHERS || pf->kind == PREFETCH_NONE) {
+                    printf("Unknown prefetcher %s.\n", optarg);
+                    return 1;
+                }
+                if (pf->degree == -1) {
+                    pf->degree = prefetchDegrees[pf->kind];
+                }
+                if (pf->degree < 1 || pf->degree > 64 || pf->latency < 0) {
+                    printf("Prefetch degree must be between 1 and 64 and latency at least 0.\n");
+                    return 1;
+                }
+                hierarchyMode = true;
+                break;
+            }
+            case 'S':
+                if (sscanf(optarg, "%lu:%lu", &sampleSets, &sampleSeed) < 1 || sampleSets < 1) {
+                    printf("-S takes <num>[:<seed>] with num at least 1.\n");
+                    return 1;
+                }
+                break;
+            case 'T':
+                if (sscanf(optarg, "%lu:%lu:%lu", &timeSkip, &timeWarmup, &timeMeasure) != 3 ||
+                    timeMeasure < 1) {
+                    printf("-T takes <skip>:<warm>:<measure> with measure at least 1.\n");
+                    return 1;
+                }
+                break;
+            case 'i':
+                interval = strtoul(optarg, NULL, 10);
+                if (interval < 1) {
+                    printf("-i takes a number of accesses, at least 1.\n");
+                    return 1;
+                }
+                break;
+            case 'V':
+                for (pageSize = 0; pageSize < NUM_PAGE_SIZES; pageSize += 1) {
+                    if (strcmp(optarg, pageSizeNames[pageSize]) == 0) {
+                        break;
+                    }
+                }
+                if (pageSize == NUM_PAGE_SIZES) {
+                    printf("Unknown page size %s.\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'c':
+                costMode = true;
+                break;
+            case 'C': {
+                int level = costParse(&costModel, optarg);
+                if (level < 0) {
+                    printf("-C takes <level>=<latency>[:<bandwidth>], level L1 to L%d or mem.\n", COST_MAX_CACHES);
+                    return 1;
+                }
+                if (level > maxCostLevel) {
+                    maxCostLevel = level;
+                }
+                costMode = true;
+                break;
+            }
             case 's':
                 setBits = atoi(optarg);
                 if (setBits > 64 || setBits < 0) {
@@ -166,8 +1199,8 @@ int main(int argc, char* argv[]) {
     }
 
     // Error checking
-    FILE* file = fopen(tracefile, "r");
-    if (file == NULL) {
+    trace_reader_t* reader = (tracefile != NULL) ? traceOpen(tracefile) : NULL;
+    if (reader == NULL) {
         printf("Invalid or unspecified tracefile.\n");
         return 1;
     }
@@ -177,65 +1210,212 @@ int main(int argc, char* argv[]) {
         printf("Invalid combination of set and block bits.\n");
         return 1;
     }
-    int tagShift = blockBits + setBits;
+    if (policy == POLICY_PLRU && (associativity & (associativity - 1)) != 0) {
+        printf("plru needs E to be a power of two.\n");
+        return 1;
+    }
+    if (interval > 0 && (hierarchyMode || curveMode || numThreads > 1 || sampleSets > 0 || timeMeasure > 0)) {
+        printf("-i cannot be combined with -m, -j, -L, -W, -I, -P, -S or -T.\n");
+        return 1;
+    }
+    if (pageSize != NUM_PAGE_SIZES && (curveMode || numThreads > 1 || sampleSets > 0 || timeMeasure > 0)) {
+        printf("-V cannot be combined with -m, -j, -S or -T.\n");
+        return 1;
+    }
+    if (costMode && (curveMode || numThreads > 1 || sampleSets > 0 || timeMeasure > 0)) {
+        printf("-c and -C cannot be combined with -m, -j, -S or -T.\n");
+        return 1;
+    }
+    if (maxCostLevel > hierarchy.numLevels) {
+        printf("-C L%d needs a simulated L%d; add levels below L1 with -L.\n", maxCostLevel, maxCostLevel);
+        return 1;
+    }
+    if (reportMode && (hierarchyMode || curveMode || numThreads > 1)) {
+        printf("-a and -A cannot be combined with -m, -j, -L, -W, -I or -P.\n");
+        return 1;
+    }
+    if (sampleSets > 0 || timeMeasure > 0) {
+        if (sampleSets > 0 && timeMeasure > 0) {
+            printf("-S and -T cannot be combined.\n");
+            return 1;
+        }
+        if (reportMode || hierarchyMode || curveMode || numThreads > 1 || enableVerbose) {
+            printf("-S and -T cannot be combined with -v, -m, -j, -L, -W, -I, -P, -a or -A.\n");
+            return 1;
+        }
+        if (sampleSets > 0 && setBits > 32) {
+            printf("With -S, s must be at most 32.\n");
+            return 1;
+        }
+        sampler_t* sampler = (sampleSets > 0) ?
+            samplerCreateSets(setBits, associativity, blockBits, policy, sampleSets, sampleSeed) :
+            samplerCreateTime(setBits, associativity, blockBits, policy, timeSkip, timeWarmup, timeMeasure);
+        if (sampler == NULL) {
+            printf("Unable to allocate cache.\n");
+            return 1;
+        }
+        int status = runSampling(reader, sampler);
+        samplerFree(sampler);
+        traceClose(reader);
+        return status;
+    }
+    if (hierarchyMode) {
+        if (curveMode || numThreads > 1) {
+            printf("-L, -W, -I and -P cannot be combined with -m or -j.\n");
+            return 1;
+        }
+        if (setBits > 32 || associativity < 1) {
+            printf("In a hierarchy, s must be at most 32 and E at least 1.\n");
+            return 1;
+        }
+        for (int i = 1; i < hierarchy.numLevels; i += 1) {
+            int lowerAssoc = hierarchy.levels[i].cache.associativity;
+            if (policy == POLICY_PLRU && (lowerAssoc & (lowerAssoc - 1)) != 0) {
+                printf("plru needs E to be a power of two.\n");
+                return 1;
+            }
+        }
+        tlb_t* tlb = NULL;
+        if (pageSize != NUM_PAGE_SIZES && (tlb = tlbCreate(pageSize)) == NULL) {
+            printf("Unable to allocate TLBs.\n");
+            return 1;
+        }
+        hierarchy.levels[0].setBits = setBits;
+        hierarchy.levels[0].cache.associativity = associativity;
+        runHierarchy(reader, &hierarchy, blockBits, policy, enableVerbose, tlb, &hits, &misses, &evictions);
+        if (costMode) {
+            cost_usage_t usage[MAX_LEVELS + 1];
+            hierarchyUsage(&hierarchy, usage);
+            costPrint(stdout, &costModel, usage, hierarchy.numLevels, usage[0].lookups,
+                      tlb ? tlbCycles(tlb) : 0.0);
+        }
+        if (tlb != NULL) {
+            tlbPrint(tlb, stdout);
+            tlbFree(tlb);
+        }
+        printSummary(hits, misses, evictions);
+        traceClose(reader);
+        return 0;
+    }
+    if (curveMode) {
+        if (setBits > STACKDIST_MAX_SET_BITS || associativity < 1) {
+            printf("With -m, s must be at most %d and E at least 1.\n", STACKDIST_MAX_SET_BITS);
+            return 1;
+        }
+        if (policy != POLICY_LRU) {
+            printf("-m derives its results from LRU stack distances and needs -p lru.\n");
+            return 1;
+        }
+        int status = runStackDist(reader, setBits, associativity, blockBits);
+        traceClose(reader);
+        return status;
+    }
+    if (numThreads > 1) {
+        if (enableVerbose) {
+            printf("-v prints accesses in trace order and cannot be used with -j.\n");
+            return 1;
+        }
+        runParallel(reader, numThreads, setBits, associativity, blockBits, policy, &hits, &misses, &evictions);
+        printSummary(hits, misses, evictions);
+        traceClose(reader);
+        return 0;
+    }
+    cachesim_t sim;
+    if (cacheSimInit(&sim, setBits, associativity, blockBits, policy) < 0) {
+        printf("Unable to allocate cache.\n");
+        return 1;
+    }
 
-    // Masks for getting setIndex and tag from full address
-    addr_t setMask = ~(0xffffffffffffffff << setBits);
-    addr_t tagMask = ~(0xffffffffffffffff << tagBits);
-    addr_t numSets = pow(2, setBits);
-    cache_t cache;
-    initCache(&cache, numSets, associativity);
+    report_t* report = NULL;
+    if (reportMode) {
+        report = reportCreate(setBits, blockBits, sim.cache.numSets * associativity);
+        if (report == NULL) {
+            printf("Unable to allocate report.\n");
+            return 1;
+        }
+        for (int i = 0; i < numRanges; i += 1) {
+            if (reportAddRange(report, rangeSpecs[i]) < 0) {
+                printf("Address ranges look like name:start-end, in hex.\n");
+                return 1;
+            }
+        }
+    }
+
+    tlb_t* tlb = NULL;
+    if (pageSize != NUM_PAGE_SIZES && (tlb = tlbCreate(pageSize)) == NULL) {
+        printf("Unable to allocate TLBs.\n");
+        return 1;
+    }
 
-    // Variables for parsed data
-    char cmd;
-    addr_t addr;
-    int bytes;
+    // Decoded trace records, processed one batch at a time. Live traces
+    // are decoded on a thread of their own, ahead of the simulation.
+    static trace_rec_t batch[BATCH_SIZE];
+    trace_rec_t* recs = batch;
+    int numRecs;
+    ingest_t ingest;
+    bool live = traceIsStream(reader);
+    if (live && ingestStart(&ingest, reader) < 0) {
+        printf("Unable to start the trace decoder.\n");
+        return 1;
+    }
 
-    addr_t setIndex, tag;
-    
     int result1, result2;
-    unsigned long timestamp = 0;
+    unsigned long nextInterval = interval;
+    unsigned long lastAccesses = 0, lastMisses = 0, lastEvictions = 0;
+    unsigned long long coreBytes = 0;
     
-    while (fscanf(file, " %c %llx,%d", &cmd, &addr, &bytes) == 3) {
-
-        tag = (addr >> tagShift) & tagMask;
-        setIndex = (addr >> blockBits) & setMask;
-        if (cmd != 'I') {
-            if (cmd == 'L' || cmd == 'S') {
-                result1 = load(&cache, setIndex, tag, associativity, timestamp);
-                result2 = 3;
-            } else { // cmd = M
-                result1 = load(&cache, setIndex, tag, associativity, timestamp);
-                result2 = load(&cache, setIndex, tag, associativity, timestamp);
-            }
-            
-            if (result1 == 0) {
-                hits += 1;
-            } else if (result1 == 1) {
-                misses += 1;
-            } else if (result1 == 2) {
-                misses += 1;
-                evictions += 1;
-            }
-
-            if (result2 == 0) {
-                hits += 1;
-            } else if (result2 == 1) {
-                misses += 1;
-            } else if (result2 == 2) {
-                misses += 1;
-                evictions += 1;
+    while ((numRecs = live ? ingestNext(&ingest, &recs) : traceRead(reader, recs, BATCH_SIZE)) > 0) {
+        for (int i = 0; i < numRecs; i += 1) {
+            char cmd = recs[i].op;
+            addr_t addr = recs[i].addr;
+
+            if (tlb != NULL) {
+                tlbAccess(tlb, addr);
+            }
+            coreBytes += recs[i].size * (1 + (cmd == 'M'));
+            result1 = cacheSimAccess(&sim, addr);
+            result2 = (cmd == 'M') ? cacheSimAccess(&sim, addr) : 3;
+
+            if (enableVerbose) {
+                printf("%c %llx,%d %s %s\n", cmd, addr, recs[i].size, strMap[result1], strMap[result2]);
+            }
+            if (report != NULL && (reportAccess(report, addr, result1) < 0 ||
+                                   (result2 != 3 && reportAccess(report, addr, result2) < 0))) {
+                printf("Unable to allocate report.\n");
+                return 1;
+            }
+            if (interval > 0 && sim.hits + sim.misses >= nextInterval) {
+                printInterval(&sim, &lastAccesses, &lastMisses, &lastEvictions);
+                nextInterval = lastAccesses + interval;
             }
-        } else {
-            continue;
-        }
-        if (enableVerbose) {
-            printf("%c %llx,%d %s %s\n", cmd, addr, bytes, strMap[result1], strMap[result2]);
         }
-        timestamp += 1;
     }
-    printSummary(hits, misses, evictions);
-    freeCache(&cache, numSets);
-    fclose(file);
+    if (numRecs < 0) {
+        printf("The trace is truncated or corrupt.\n");
+        return 1;
+    }
+    if (interval > 0 && sim.hits + sim.misses > lastAccesses) {
+        printInterval(&sim, &lastAccesses, &lastMisses, &lastEvictions);
+    }
+    if (live) {
+        ingestStop(&ingest);
+    }
+    if (report != NULL) {
+        reportPrint(report, stdout);
+        reportFree(report);
+    }
+    if (costMode) {
+        // Without dirty bits, memory only serves the blocks L1 misses on
+        cost_usage_t usage[2] = {{sim.hits + sim.misses, coreBytes},
+                                 {sim.misses, (unsigned long long) sim.misses << blockBits}};
+        costPrint(stdout, &costModel, usage, 1, usage[0].lookups, tlb ? tlbCycles(tlb) : 0.0);
+    }
+    if (tlb != NULL) {
+        tlbPrint(tlb, stdout);
+        tlbFree(tlb);
+    }
+    printSummary(sim.hits, sim.misses, sim.evictions);
+    cacheSimFree(&sim);
+    traceClose(reader);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,331 @@
+/*
+ * fasttrans.c - Scalar, SSE2 and AVX2 transpose kernels with CPU dispatch
+ *
+ * Every kernel shares the tiling; only the 8 x 8 block transpose differs.
+ * DEFINE_TILE stamps out one tile function per block transpose so that the
+ * block code inlines, compiled for the block's instruction set. The
+ * parallel transpose splits A's columns into one band per worker.
+ */
+#include <stdlib.h>
+#include <pthread.h>
+#include "fasttrans.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+char* kernelNames[NUM_KERNELS] = {"auto", "scalar", "sse2", "avx2"};
+
+
+bool kernelSupported(trans_kernel_t kernel) {
+    switch (kernel) {
+        case KERNEL_AUTO:
+        case KERNEL_SCALAR:
+            return true;
+#ifdef HAVE_X86
+        case KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+
+trans_kernel_t kernelResolve(trans_kernel_t kernel) {
+    if (kernel != KERNEL_AUTO) {
+        return kernel;
+    }
+    for (kernel = NUM_KERNELS - 1; kernel > KERNEL_SCALAR; kernel -= 1) {
+        if (kernelSupported(kernel)) {
+            return kernel;
+        }
+    }
+    return KERNEL_SCALAR;
+}
+
+
+static inline void scalarBlock8x8(const int32_t* a, size_t lda, int32_t* b, size_t ldb) {
+    for (int i = 0; i < 8; i += 1) {
+        for (int j = 0; j < 8; j += 1) {
+            b[j * ldb + i] = a[i * lda + j];
+        }
+    }
+}
+
+
+#ifdef HAVE_X86
+__attribute__((target("sse2")))
+static inline void sse2Block4x4(const int32_t* a, size_t lda, int32_t* b, size_t ldb) {
+    __m128i r0 = _mm_loadu_si128((const __m128i*) a);
+    __m128i r1 = _mm_loadu_si128((const __m128i*) (a + lda));
+    __m128i r2 = _mm_loadu_si128((const __m128i*) (a + 2 * lda));
+    __m128i r3 = _mm_loadu_si128((const __m128i*) (a + 3 * lda));
+
+    // Interleave pairs of rows, then pairs of pairs: column k of A ends up in
+    // one register
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);   // a00 a10 a01 a11
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);   // a20 a30 a21 a31
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);   // a02 a12 a03 a13
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);   // a22 a32 a23 a33
+    _mm_storeu_si128((__m128i*) b, _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i*) (b + ldb), _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128((__m128i*) (b + 2 * ldb), _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128((__m128i*) (b + 3 * ldb), _mm_unpackhi_epi64(t2, t3));
+}
+
+
+__attribute__((target("sse2")))
+static inline void sse2Block8x8(const int32_t* a, size_t lda, int32_t* b, size_t ldb) {
+    sse2Block4x4(a, lda, b, ldb);
+    sse2Block4x4(a + 4, lda, b + 4 * ldb, ldb);
+    sse2Block4x4(a + 4 * lda, lda, b + 4, ldb);
+    sse2Block4x4(a + 4 * lda + 4, lda, b + 4 * ldb + 4, ldb);
+}
+
+
+__attribute__((target("avx2")))
+static inline void avx2Block8x8(const int32_t* a, size_t lda, int32_t* b, size_t ldb) {
+    __m256i r[8], t[8], u[8];
+
+    for (int i = 0; i < 8; i += 1) {
+        r[i] = _mm256_loadu_si256((const __m256i*) (a + i * lda));
+    }
+    // Within each 128-bit lane, as in sse2Block4x4: u[k] holds column k of
+    // rows 0-3 (low lane) and column k + 4 (high lane), u[k + 4] the same
+    // for rows 4-7
+    for (int i = 0; i < 8; i += 4) {
+        t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+        t[i + 2] = _mm256_unpacklo_epi32(r[i + 2], r[i + 3]);
+        t[i + 3] = _mm256_unpackhi_epi32(r[i + 2], r[i + 3]);
+        u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+    // Join the low lanes of rows 0-3 and 4-7 for columns 0-3, the high lanes
+    // for columns 4-7
+    for (int k = 0; k < 4; k += 1) {
+        _mm256_storeu_si256((__m256i*) (b + k * ldb), _mm256_permute2x128_si256(u[k], u[k + 4], 0x20));
+        _mm256_storeu_si256((__m256i*) (b + (k + 4) * ldb), _mm256_permute2x128_si256(u[k], u[k + 4], 0x31));
+    }
+}
+#endif
+
+
+/*
+Transposes rows r0..r1-1, columns c0..c1-1 of a into b: full 8 x 8 blocks
+with block(), the ragged right and bottom strips element by element.
+*/
+#define DEFINE_TILE(name, block, attr) \
+attr static void name(const int32_t* a, int32_t* b, size_t rows, size_t cols, \
+                      size_t r0, size_t r1, size_t c0, size_t c1) { \
+    size_t r8 = r0 + (r1 - r0) / 8 * 8; \
+    size_t c8 = c0 + (c1 - c0) / 8 * 8; \
+    for (size_t i = r0; i < r8; i += 8) { \
+        for (size_t j = c0; j < c8; j += 8) { \
+            block(a + i * cols + j, cols, b + j * rows + i, rows); \
+        } \
+    } \
+    for (size_t i = r0; i < r1; i += 1) { \
+        for (size_t j = (i < r8) ? c8 : c0; j < c1; j += 1) { \
+            b[j * rows + i] = a[i * cols + j]; \
+        } \
+    } \
+}
+
+DEFINE_TILE(scalarTile, scalarBlock8x8, )
+#ifdef HAVE_X86
+DEFINE_TILE(sse2Tile, sse2Block8x8, __attribute__((target("sse2"))))
+DEFINE_TILE(avx2Tile, avx2Block8x8, __attribute__((target("avx2"))))
+#endif
+
+
+typedef void (*tile_fn_t)(const int32_t*, int32_t*, size_t, size_t, size_t, size_t, size_t, size_t);
+
+static tile_fn_t tileFunction(trans_kernel_t kernel) {
+#ifdef HAVE_X86
+    switch (kernelResolve(kernel)) {
+        case KERNEL_SSE2:
+            return sse2Tile;
+        case KERNEL_AVX2:
+            return avx2Tile;
+        default:
+            break;
+    }
+#endif
+    return scalarTile;
+}
+
+
+/* Transposes the tiles of columns c0..c1-1 of a, over all rows */
+static void transposeColumns(tile_fn_t tile, const int32_t* a, int32_t* b, size_t rows, size_t cols,
+                             size_t c0, size_t c1) {
+    for (size_t r = 0; r < rows; r += TRANS_TILE) {
+        size_t r1 = (r + TRANS_TILE < rows) ? r + TRANS_TILE : rows;
+        for (size_t c = c0; c < c1; c += TRANS_TILE) {
+            tile(a, b, rows, cols, r, r1, c, (c + TRANS_TILE < c1) ? c + TRANS_TILE : c1);
+        }
+    }
+}
+
+
+void fastTranspose(const int32_t* a, int32_t* b, size_t rows, size_t cols, trans_kernel_t kernel) {
+    transposeColumns(tileFunction(kernel), a, b, rows, cols, 0, cols);
+}
+
+
+/*
+Workers sleep on start until generation moves past the last job they ran,
+run it, and the last one to finish signals done.
+*/
+struct trans_pool {
+    int numThreads;
+    pthread_t threads[MAX_POOL_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation;
+    int running;     // workers (other than the caller) still in the job
+    bool stop;
+    void (*fn)(void* arg, int t, int numThreads);
+    void* arg;
+};
+
+typedef struct poolWorker {
+    trans_pool_t* pool;
+    int t;
+} pool_worker_t;
+
+
+static void* poolMain(void* arg) {
+    pool_worker_t self = *(pool_worker_t*) arg;
+    trans_pool_t* pool = self.pool;
+    unsigned long seen = 0;
+
+    free(arg);
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->stop) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stop) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        pool->fn(pool->arg, self.t, pool->numThreads);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+
+trans_pool_t* transPoolCreate(int numThreads) {
+    if (numThreads < 1 || numThreads > MAX_POOL_THREADS) {
+        return NULL;
+    }
+    trans_pool_t* pool = calloc(1, sizeof(trans_pool_t));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (int t = 1; t < numThreads; t += 1) {
+        pool_worker_t* w = malloc(sizeof(pool_worker_t));
+        if (w == NULL) {
+            transPoolFree(pool);
+            return NULL;
+        }
+        *w = (pool_worker_t) {pool, t};
+        if (pthread_create(&pool->threads[t], NULL, poolMain, w) != 0) {
+            free(w);
+            transPoolFree(pool);
+            return NULL;
+        }
+        pool->numThreads = t + 1;
+    }
+    pool->numThreads = numThreads;
+    return pool;
+}
+
+
+void transPoolRun(trans_pool_t* pool, void (*fn)(void* arg, int t, int numThreads), void* arg) {
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->running = pool->numThreads - 1;
+    pool->generation += 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    fn(arg, 0, pool->numThreads);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+void transPoolFree(trans_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int t = 1; t < pool->numThreads; t += 1) {
+        pthread_join(pool->threads[t], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool);
+}
+
+
+void transBand(size_t n, int t, int numThreads, size_t* start, size_t* end) {
+    size_t tiles = (n + TRANS_TILE - 1) / TRANS_TILE;
+
+    *start = tiles * t / numThreads * TRANS_TILE;
+    *end = tiles * (t + 1) / numThreads * TRANS_TILE;
+    if (*start > n) {
+        *start = n;
+    }
+    if (*end > n) {
+        *end = n;
+    }
+}
+
+
+typedef struct parallelJob {
+    tile_fn_t tile;
+    const int32_t* a;
+    int32_t* b;
+    size_t rows, cols;
+} parallel_job_t;
+
+
+static void parallelBand(void* arg, int t, int numThreads) {
+    parallel_job_t* job = (parallel_job_t*) arg;
+    size_t c0, c1;
+
+    transBand(job->cols, t, numThreads, &c0, &c1);
+    transposeColumns(job->tile, job->a, job->b, job->rows, job->cols, c0, c1);
+}
+
+
+void fastTransposeParallel(trans_pool_t* pool, const int32_t* a, int32_t* b,
+                           size_t rows, size_t cols, trans_kernel_t kernel) {
+    parallel_job_t job = {tileFunction(kernel), a, b, rows, cols};
+    transPoolRun(pool, parallelBand, &job);
+}
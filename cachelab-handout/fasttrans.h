@@ -0,0 +1,80 @@
+/*
+ * fasttrans.h - Native int32 transpose kernels for large matrices
+ *
+ * The functions in trans.c are written for the simulated 1 KB cache; these
+ * are for transposing on the host. The matrix is walked in TRANS_TILE
+ * square tiles, each tile in 8 x 8 blocks transposed in registers: as four
+ * 4 x 4 SSE2 transposes, or with AVX2 unpacks and lane permutes. Blocks
+ * cut by the matrix edge are finished by scalar code, and nothing needs to
+ * be aligned. KERNEL_AUTO picks the widest kernel the CPU supports. Tiles
+ * can also be shared out over a pool of threads.
+ */
+
+#ifndef FASTTRANS_H
+#define FASTTRANS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRANS_TILE 64   // tile side in elements: 16 KB of A and of B
+
+typedef enum trans_kernel {
+    KERNEL_AUTO,
+    KERNEL_SCALAR,
+    KERNEL_SSE2,
+    KERNEL_AVX2,
+    NUM_KERNELS
+} trans_kernel_t;
+
+extern char* kernelNames[NUM_KERNELS];
+
+/* kernelSupported - Whether this CPU can run kernel (KERNEL_AUTO always) */
+bool kernelSupported(trans_kernel_t kernel);
+
+/* kernelResolve - The kernel that KERNEL_AUTO stands for on this CPU */
+trans_kernel_t kernelResolve(trans_kernel_t kernel);
+
+/*
+ * fastTranspose - Write the cols x rows transpose of the row-major
+ *     rows x cols matrix a to b with the given kernel, which must be
+ *     supported. a and b must not overlap.
+ */
+void fastTranspose(const int32_t* a, int32_t* b, size_t rows, size_t cols, trans_kernel_t kernel);
+
+/*
+ * A pool of worker threads for the parallel transpose. The calling thread
+ * is worker 0, so a pool of one thread starts no threads at all.
+ */
+#define MAX_POOL_THREADS 64
+
+typedef struct trans_pool trans_pool_t;
+
+/* transPoolCreate - Start numThreads - 1 workers. Returns NULL on failure. */
+trans_pool_t* transPoolCreate(int numThreads);
+
+/*
+ * transPoolRun - Call fn(arg, t, numThreads) on every worker t at once,
+ *     returning when all calls have
+ */
+void transPoolRun(trans_pool_t* pool, void (*fn)(void* arg, int t, int numThreads), void* arg);
+
+/* transPoolFree - Stop the workers and release the pool */
+void transPoolFree(trans_pool_t* pool);
+
+/*
+ * transBand - The part [*start, *end) of 0..n-1, in whole TRANS_TILE
+ *     steps, that worker t of numThreads owns
+ */
+void transBand(size_t n, int t, int numThreads, size_t* start, size_t* end);
+
+/*
+ * fastTransposeParallel - fastTranspose on pool. Worker t transposes the
+ *     tiles of band t of A's columns, so it writes one contiguous band of
+ *     b's rows; first-touching that band from the same worker (transBand
+ *     over cols) keeps its pages on the worker's NUMA node.
+ */
+void fastTransposeParallel(trans_pool_t* pool, const int32_t* a, int32_t* b,
+                           size_t rows, size_t cols, trans_kernel_t kernel);
+
+#endif /* FASTTRANS_H */
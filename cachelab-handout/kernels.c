@@ -0,0 +1,313 @@
+/*
+ * kernels.c - Memory kernels other than transpose, for test-trans -K
+ *
+ * Each kernel has a setup function, which allocates its buffers with
+ * kernelAlloc and fills them, a size function giving the bytes setup
+ * will allocate, and a run function, whose loads and stores of those
+ * buffers are simulated like a transpose function's. All take
+ * the parameters, in the order the registration names them, with the
+ * defaults given there unless test-trans -P overrides them, and the
+ * buffers in the order setup put them in bufs.
+ */
+#include <stdint.h>
+#include "cachelab.h"
+
+/*
+ * next_random - A fixed xorshift sequence, so that the index vectors and
+ *     the miss counts they lead to are the same on every run
+ */
+static unsigned int random_state;
+
+static unsigned int next_random(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+/*
+ * int_arrays - Bytes of arrays arrays of count ints each, or SIZE_MAX if
+ *     that does not fit a size_t
+ */
+static size_t int_arrays(size_t count, int arrays)
+{
+    if (count > SIZE_MAX / sizeof(int) / arrays)
+        return SIZE_MAX;
+    return count * sizeof(int) * arrays;
+}
+
+/*
+ * setup_vectors - n-int source and destination
+ */
+void setup_vectors(int params[], void *bufs[])
+{
+    int n = params[0], i;
+    int *src = kernelAlloc(n * sizeof(int));
+    int *dst = kernelAlloc(n * sizeof(int));
+
+    for (i = 0; i < n; i++) {
+        src[i] = i;
+        dst[i] = 0;
+    }
+    bufs[0] = src;
+    bufs[1] = dst;
+}
+
+/* vectors_size - Bytes setup_vectors allocates */
+size_t vectors_size(int params[])
+{
+    return int_arrays(params[0], 2);
+}
+
+/*
+ * memcpy_forward - Copy n ints front to back
+ */
+char memcpy_forward_desc[] = "memcpy, forward";
+void memcpy_forward(int params[], void *bufs[])
+{
+    int n = params[0], i;
+    int *src = bufs[0], *dst = bufs[1];
+
+    for (i = 0; i < n; i++)
+        dst[i] = src[i];
+}
+
+/*
+ * memcpy_backward - Copy n ints back to front
+ */
+char memcpy_backward_desc[] = "memcpy, backward";
+void memcpy_backward(int params[], void *bufs[])
+{
+    int n = params[0], i;
+    int *src = bufs[0], *dst = bufs[1];
+
+    for (i = n - 1; i >= 0; i--)
+        dst[i] = src[i];
+}
+
+/*
+ * memcpy_strided - Copy n ints in stride passes: first every stride'th
+ *     int, then the ones after those, and so on
+ */
+char memcpy_strided_desc[] = "memcpy, strided passes";
+void memcpy_strided(int params[], void *bufs[])
+{
+    int n = params[0], stride = params[1], i, j;
+    int *src = bufs[0], *dst = bufs[1];
+
+    for (j = 0; j < stride; j++)
+        for (i = j; i < n; i += stride)
+            dst[i] = src[i];
+}
+
+/*
+ * setup_indexed - n-int source and destination and an index vector:
+ *     a random permutation of 0..n-1
+ */
+void setup_indexed(int params[], void *bufs[])
+{
+    int n = params[0], i, j, t;
+    int *idx;
+
+    setup_vectors(params, bufs);
+    idx = kernelAlloc(n * sizeof(int));
+    random_state = 2463534242u;
+    for (i = 0; i < n; i++)
+        idx[i] = i;
+    for (i = n - 1; i > 0; i--) {
+        j = next_random() % (i + 1);
+        t = idx[i];
+        idx[i] = idx[j];
+        idx[j] = t;
+    }
+    bufs[2] = idx;
+}
+
+/* indexed_size - Bytes setup_indexed allocates */
+size_t indexed_size(int params[])
+{
+    return int_arrays(params[0], 3);
+}
+
+/*
+ * gather - dst[i] = src[idx[i]]: sequential writes, random reads
+ */
+char gather_desc[] = "Gather through a random permutation";
+void gather(int params[], void *bufs[])
+{
+    int n = params[0], i;
+    int *src = bufs[0], *dst = bufs[1], *idx = bufs[2];
+
+    for (i = 0; i < n; i++)
+        dst[i] = src[idx[i]];
+}
+
+/*
+ * scatter - dst[idx[i]] = src[i]: sequential reads, random writes
+ */
+char scatter_desc[] = "Scatter through a random permutation";
+void scatter(int params[], void *bufs[])
+{
+    int n = params[0], i;
+    int *src = bufs[0], *dst = bufs[1], *idx = bufs[2];
+
+    for (i = 0; i < n; i++)
+        dst[idx[i]] = src[i];
+}
+
+/*
+ * setup_matmul - n x n matrices A and B of small values, and C = 0
+ */
+void setup_matmul(int params[], void *bufs[])
+{
+    int n = params[0], i;
+    int *a = kernelAlloc((size_t) n * n * sizeof(int));
+    int *b = kernelAlloc((size_t) n * n * sizeof(int));
+    int *c = kernelAlloc((size_t) n * n * sizeof(int));
+
+    for (i = 0; i < n * n; i++) {
+        a[i] = i % 7;
+        b[i] = i % 5;
+        c[i] = 0;
+    }
+    bufs[0] = a;
+    bufs[1] = b;
+    bufs[2] = c;
+}
+
+/* matmul_size - Bytes setup_matmul allocates */
+size_t matmul_size(int params[])
+{
+    return int_arrays((size_t) params[0] * params[0], 3);
+}
+
+/*
+ * matmul_ijk - C += A B with the textbook loop order: B walked by columns
+ */
+char matmul_ijk_desc[] = "Matrix multiply, ijk";
+void matmul_ijk(int params[], void *bufs[])
+{
+    int n = params[0], i, j, k, sum;
+    int *a = bufs[0], *b = bufs[1], *c = bufs[2];
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            sum = c[i * n + j];
+            for (k = 0; k < n; k++)
+                sum += a[i * n + k] * b[k * n + j];
+            c[i * n + j] = sum;
+        }
+    }
+}
+
+/*
+ * matmul_ikj - C += A B with B and C both walked by rows
+ */
+char matmul_ikj_desc[] = "Matrix multiply, ikj";
+void matmul_ikj(int params[], void *bufs[])
+{
+    int n = params[0], i, j, k, r;
+    int *a = bufs[0], *b = bufs[1], *c = bufs[2];
+
+    for (i = 0; i < n; i++) {
+        for (k = 0; k < n; k++) {
+            r = a[i * n + k];
+            for (j = 0; j < n; j++)
+                c[i * n + j] += r * b[k * n + j];
+        }
+    }
+}
+
+/*
+ * matmul_blocked - ikj in bsize x bsize blocks of all three matrices
+ */
+char matmul_blocked_desc[] = "Matrix multiply, ikj in blocks";
+void matmul_blocked(int params[], void *bufs[])
+{
+    int n = params[0], bsize = params[1], i, j, k, i0, j0, k0, r;
+    int *a = bufs[0], *b = bufs[1], *c = bufs[2];
+
+    for (i0 = 0; i0 < n; i0 += bsize)
+        for (k0 = 0; k0 < n; k0 += bsize)
+            for (j0 = 0; j0 < n; j0 += bsize)
+                for (i = i0; i < i0 + bsize && i < n; i++)
+                    for (k = k0; k < k0 + bsize && k < n; k++) {
+                        r = a[i * n + k];
+                        for (j = j0; j < j0 + bsize && j < n; j++)
+                            c[i * n + j] += r * b[k * n + j];
+                    }
+}
+
+/*
+ * setup_grid - n x n source grid and destination grid
+ */
+void setup_grid(int params[], void *bufs[])
+{
+    size_t cells = (size_t) params[0] * params[0], i;
+    int *src = kernelAlloc(cells * sizeof(int));
+    int *dst = kernelAlloc(cells * sizeof(int));
+
+    for (i = 0; i < cells; i++) {
+        src[i] = i;
+        dst[i] = 0;
+    }
+    bufs[0] = src;
+    bufs[1] = dst;
+}
+
+/* grid_size - Bytes setup_grid allocates */
+size_t grid_size(int params[])
+{
+    return int_arrays((size_t) params[0] * params[0], 2);
+}
+
+/*
+ * stencil_5pt - One Jacobi step of the 5-point stencil over the interior
+ */
+char stencil_5pt_desc[] = "5-point stencil, one sweep";
+void stencil_5pt(int params[], void *bufs[])
+{
+    int n = params[0], i, j;
+    int *src = bufs[0], *dst = bufs[1];
+
+    for (i = 1; i < n - 1; i++)
+        for (j = 1; j < n - 1; j++)
+            dst[i * n + j] = (src[(i - 1) * n + j] + src[(i + 1) * n + j] +
+                              src[i * n + j - 1] + src[i * n + j + 1] +
+                              src[i * n + j]) / 5;
+}
+
+/*
+ * stencil_5pt_columns - The same sweep, column by column
+ */
+char stencil_5pt_columns_desc[] = "5-point stencil, by columns";
+void stencil_5pt_columns(int params[], void *bufs[])
+{
+    int n = params[0], i, j;
+    int *src = bufs[0], *dst = bufs[1];
+
+    for (j = 1; j < n - 1; j++)
+        for (i = 1; i < n - 1; i++)
+            dst[i * n + j] = (src[(i - 1) * n + j] + src[(i + 1) * n + j] +
+                              src[i * n + j - 1] + src[i * n + j + 1] +
+                              src[i * n + j]) / 5;
+}
+
+/*
+ * registerKernels - Register the kernels test-trans -K evaluates, with
+ *     their parameters and defaults
+ */
+void registerKernels()
+{
+    registerKernel(setup_vectors, vectors_size, memcpy_forward, memcpy_forward_desc, "n=1024");
+    registerKernel(setup_vectors, vectors_size, memcpy_backward, memcpy_backward_desc, "n=1024");
+    registerKernel(setup_vectors, vectors_size, memcpy_strided, memcpy_strided_desc, "n=1024 stride=8");
+    registerKernel(setup_indexed, indexed_size, gather, gather_desc, "n=1024");
+    registerKernel(setup_indexed, indexed_size, scatter, scatter_desc, "n=1024");
+    registerKernel(setup_matmul, matmul_size, matmul_ijk, matmul_ijk_desc, "n=32");
+    registerKernel(setup_matmul, matmul_size, matmul_ikj, matmul_ikj_desc, "n=32");
+    registerKernel(setup_matmul, matmul_size, matmul_blocked, matmul_blocked_desc, "n=32 bsize=8");
+    registerKernel(setup_grid, grid_size, stencil_5pt, stencil_5pt_desc, "n=64");
+    registerKernel(setup_grid, grid_size, stencil_5pt_columns, stencil_5pt_columns_desc, "n=64");
+}
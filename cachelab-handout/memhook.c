@@ -0,0 +1,53 @@
+/*
+ * memhook.c - The __tsan_* entry points gcc -fsanitize=thread calls
+ *
+ * Only the plain, unaligned and range reads and writes report anything;
+ * function entry/exit and initialization are no-ops.
+ */
+#include <stddef.h>
+#include "memhook.h"
+
+static mem_hook_t hook = NULL;
+static void* hookCtx = NULL;
+
+void memHookSet(mem_hook_t newHook, void* ctx) {
+    hookCtx = ctx;
+    hook = newHook;
+}
+
+
+static inline void forward(const void* addr, int size, char op) {
+    if (hook) {
+        hook(hookCtx, (addr_t) (size_t) addr, size, op);
+    }
+}
+
+
+/* Prototypes first: -Wall asks for them and nothing else declares these */
+#define DEFINE_SIZED(n) \
+    void __tsan_read##n(void* addr); \
+    void __tsan_write##n(void* addr); \
+    void __tsan_unaligned_read##n(void* addr); \
+    void __tsan_unaligned_write##n(void* addr); \
+    void __tsan_read##n(void* addr) { forward(addr, n, 'L'); } \
+    void __tsan_write##n(void* addr) { forward(addr, n, 'S'); } \
+    void __tsan_unaligned_read##n(void* addr) { forward(addr, n, 'L'); } \
+    void __tsan_unaligned_write##n(void* addr) { forward(addr, n, 'S'); }
+
+DEFINE_SIZED(1)
+DEFINE_SIZED(2)
+DEFINE_SIZED(4)
+DEFINE_SIZED(8)
+DEFINE_SIZED(16)
+
+void __tsan_read_range(void* addr, size_t size);
+void __tsan_write_range(void* addr, size_t size);
+void __tsan_func_entry(void* pc);
+void __tsan_func_exit(void);
+void __tsan_init(void);
+
+void __tsan_read_range(void* addr, size_t size) { forward(addr, (int) size, 'L'); }
+void __tsan_write_range(void* addr, size_t size) { forward(addr, (int) size, 'S'); }
+void __tsan_func_entry(void* pc) {}
+void __tsan_func_exit(void) {}
+void __tsan_init(void) {}
@@ -0,0 +1,25 @@
+/*
+ * memhook.h - Load/store hooks for code compiled with -fsanitize=thread
+ *
+ * gcc -fsanitize=thread makes every load and store call __tsan_read<n> or
+ * __tsan_write<n> first. memhook.c defines those entry points itself, so
+ * an object built that way (trans-inst.o) links without the ThreadSanitizer
+ * runtime, and passes each access to a callback while one is installed.
+ * test-trans -i uses this to trace the transpose functions in-process.
+ */
+
+#ifndef MEMHOOK_H
+#define MEMHOOK_H
+
+#include "traceio.h"
+
+/* Called once per access with op 'L' or 'S' */
+typedef void (*mem_hook_t)(void* ctx, addr_t addr, int size, char op);
+
+/*
+ * memHookSet - Send the accesses of instrumented code to hook(ctx, ...)
+ *     from now on; a NULL hook turns tracing off.
+ */
+void memHookSet(mem_hook_t hook, void* ctx);
+
+#endif /* MEMHOOK_H */
@@ -0,0 +1,291 @@
+/*
+ * report.c - Per-set, per-page and per-range miss attribution
+ *
+ * Sets and pages are counted in growable tables of rows, found through an
+ * addr_map_t (cachesim.h) from key to row, so only touched sets and pages
+ * cost memory. Another map, without rows, remembers every block seen for
+ * the compulsory test. The fully associative shadow cache is an LRU list
+ * of numLines lines with a chained hash from block to line.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "cachesim.h"
+#include "report.h"
+
+typedef struct counts {
+    unsigned long hits, misses, evictions;
+    unsigned long compulsory, capacity, conflict;
+} counts_t;
+
+typedef struct row {
+    addr_t key;
+    counts_t counts;
+} row_t;
+
+typedef struct table {
+    addr_map_t index;    // key -> row
+    row_t* rows;
+    int numRows;
+    int cap;
+} table_t;
+
+typedef struct range {
+    char name[32];
+    addr_t start, end;
+    counts_t counts;
+} range_t;
+
+/* Fully associative LRU cache of whole blocks */
+typedef struct shadow {
+    addr_t numLines;
+    addr_t used;
+    addr_t* blocks;
+    int64_t* newer;    // LRU list links, -1 at the ends
+    int64_t* older;
+    int64_t* chain;    // next line in the same hash bucket, -1 at the end
+    int64_t* buckets;
+    addr_t numBuckets; // power of two
+    int64_t mru, lru;
+} shadow_t;
+
+struct report {
+    int setBits;
+    int blockBits;
+    addr_t setMask;
+    table_t sets;
+    table_t pages;
+    range_t ranges[REPORT_MAX_RANGES];
+    int numRanges;
+    addr_map_t seen;   // blocks touched so far
+    shadow_t shadow;
+    counts_t total;
+};
+
+
+/* Returns the counts row for key, adding a zeroed one if needed */
+static counts_t* tableRow(table_t* table, addr_t key) {
+    int row = table->numRows;
+    int found = mapFindOrAdd(&table->index, key, &row);
+    if (found < 0) {
+        return NULL;
+    }
+    if (!found) {
+        if (table->numRows == table->cap) {
+            int cap = table->cap ? table->cap * 2 : 256;
+            row_t* rows = realloc(table->rows, cap * sizeof(row_t));
+            if (rows == NULL) {
+                return NULL;
+            }
+            table->rows = rows;
+            table->cap = cap;
+        }
+        memset(&table->rows[row], 0, sizeof(row_t));
+        table->rows[row].key = key;
+        table->numRows += 1;
+    }
+    return &table->rows[row].counts;
+}
+
+
+static int shadowInit(shadow_t* sh, addr_t numLines) {
+    sh->numLines = numLines;
+    sh->used = 0;
+    sh->mru = sh->lru = -1;
+    for (sh->numBuckets = 1; sh->numBuckets < 2 * numLines; sh->numBuckets *= 2);
+    sh->blocks = malloc(numLines * sizeof(addr_t));
+    sh->newer = malloc(numLines * sizeof(int64_t));
+    sh->older = malloc(numLines * sizeof(int64_t));
+    sh->chain = malloc(numLines * sizeof(int64_t));
+    sh->buckets = malloc(sh->numBuckets * sizeof(int64_t));
+    if (!sh->blocks || !sh->newer || !sh->older || !sh->chain || !sh->buckets) {
+        return -1;
+    }
+    memset(sh->buckets, -1, sh->numBuckets * sizeof(int64_t));
+    return 0;
+}
+
+
+static void shadowUnlink(shadow_t* sh, int64_t line) {
+    if (sh->newer[line] != -1) {
+        sh->older[sh->newer[line]] = sh->older[line];
+    } else {
+        sh->mru = sh->older[line];
+    }
+    if (sh->older[line] != -1) {
+        sh->newer[sh->older[line]] = sh->newer[line];
+    } else {
+        sh->lru = sh->newer[line];
+    }
+}
+
+
+static void shadowPushMru(shadow_t* sh, int64_t line) {
+    sh->newer[line] = -1;
+    sh->older[line] = sh->mru;
+    if (sh->mru != -1) {
+        sh->newer[sh->mru] = line;
+    } else {
+        sh->lru = line;
+    }
+    sh->mru = line;
+}
+
+
+/* Accesses block in the fully associative cache; returns true on a hit */
+static bool shadowAccess(shadow_t* sh, addr_t block) {
+    int64_t* bucket = &sh->buckets[hashAddr(block, sh->numBuckets)];
+    int64_t line;
+
+    for (line = *bucket; line != -1; line = sh->chain[line]) {
+        if (sh->blocks[line] == block) {
+            shadowUnlink(sh, line);
+            shadowPushMru(sh, line);
+            return true;
+        }
+    }
+    if (sh->used < sh->numLines) {
+        line = sh->used++;
+    } else {
+        // Evict the LRU line and take it out of its bucket's chain
+        line = sh->lru;
+        shadowUnlink(sh, line);
+        int64_t* link = &sh->buckets[hashAddr(sh->blocks[line], sh->numBuckets)];
+        while (*link != line) {
+            link = &sh->chain[*link];
+        }
+        *link = sh->chain[line];
+    }
+    sh->blocks[line] = block;
+    sh->chain[line] = *bucket;
+    *bucket = line;
+    shadowPushMru(sh, line);
+    return false;
+}
+
+
+report_t* reportCreate(int setBits, int blockBits, addr_t numLines) {
+    report_t* rep = calloc(1, sizeof(report_t));
+    if (rep == NULL) {
+        return NULL;
+    }
+    rep->setBits = setBits;
+    rep->blockBits = blockBits;
+    rep->setMask = setBits < 64 ? ~(~0ULL << setBits) : ~0ULL;
+    if (mapInit(&rep->sets.index, 512) < 0 || mapInit(&rep->pages.index, 512) < 0 ||
+        mapInit(&rep->seen, 512) < 0 || shadowInit(&rep->shadow, numLines) < 0) {
+        reportFree(rep);
+        return NULL;
+    }
+    return rep;
+}
+
+
+int reportAddRange(report_t* rep, const char* spec) {
+    if (rep->numRanges == REPORT_MAX_RANGES) {
+        return -1;
+    }
+    range_t* r = &rep->ranges[rep->numRanges];
+    memset(r, 0, sizeof(range_t));
+    if (sscanf(spec, "%31[^:]:%llx-%llx", r->name, &r->start, &r->end) != 3 || r->end <= r->start) {
+        return -1;
+    }
+    rep->numRanges += 1;
+    return 0;
+}
+
+
+static inline void charge(counts_t* c, int result, int kind) {
+    if (result == 0) {
+        c->hits += 1;
+        return;
+    }
+    c->misses += 1;
+    c->evictions += (result == 2);
+    c->compulsory += (kind == 0);
+    c->capacity += (kind == 1);
+    c->conflict += (kind == 2);
+}
+
+
+int reportAccess(report_t* rep, addr_t addr, int result) {
+    addr_t block = addr >> rep->blockBits;
+    int unused = 0;
+
+    // Miss kind: 0 compulsory, 1 capacity, 2 conflict
+    int seen = mapFindOrAdd(&rep->seen, block, &unused);
+    bool faHit = shadowAccess(&rep->shadow, block);
+    if (seen < 0) {
+        return -1;
+    }
+    int kind = !seen ? 0 : faHit ? 2 : 1;
+
+    counts_t* set = tableRow(&rep->sets, block & rep->setMask);
+    counts_t* page = tableRow(&rep->pages, addr >> REPORT_PAGE_BITS);
+    if (set == NULL || page == NULL) {
+        return -1;
+    }
+    charge(set, result, kind);
+    charge(page, result, kind);
+    charge(&rep->total, result, kind);
+    for (int i = 0; i < rep->numRanges; i += 1) {
+        if (addr >= rep->ranges[i].start && addr < rep->ranges[i].end) {
+            charge(&rep->ranges[i].counts, result, kind);
+        }
+    }
+    return 0;
+}
+
+
+static int compareRows(const void* a, const void* b) {
+    addr_t x = ((const row_t*) a)->key;
+    addr_t y = ((const row_t*) b)->key;
+    return (x > y) - (x < y);
+}
+
+
+static void printCounts(FILE* out, const counts_t* c) {
+    fprintf(out, " hits:%lu misses:%lu evictions:%lu compulsory:%lu capacity:%lu conflict:%lu\n",
+            c->hits, c->misses, c->evictions, c->compulsory, c->capacity, c->conflict);
+}
+
+
+void reportPrint(report_t* rep, FILE* out) {
+    qsort(rep->sets.rows, rep->sets.numRows, sizeof(row_t), compareRows);
+    qsort(rep->pages.rows, rep->pages.numRows, sizeof(row_t), compareRows);
+
+    for (int i = 0; i < rep->sets.numRows; i += 1) {
+        fprintf(out, "set %llu:", rep->sets.rows[i].key);
+        printCounts(out, &rep->sets.rows[i].counts);
+    }
+    for (int i = 0; i < rep->pages.numRows; i += 1) {
+        fprintf(out, "page %llx:", rep->pages.rows[i].key << REPORT_PAGE_BITS);
+        printCounts(out, &rep->pages.rows[i].counts);
+    }
+    for (int i = 0; i < rep->numRanges; i += 1) {
+        range_t* r = &rep->ranges[i];
+        fprintf(out, "range %s %llx-%llx:", r->name, r->start, r->end);
+        printCounts(out, &r->counts);
+    }
+    fprintf(out, "total:");
+    printCounts(out, &rep->total);
+}
+
+
+void reportFree(report_t* rep) {
+    if (rep == NULL) {
+        return;
+    }
+    mapFree(&rep->sets.index);
+    free(rep->sets.rows);
+    mapFree(&rep->pages.index);
+    free(rep->pages.rows);
+    mapFree(&rep->seen);
+    free(rep->shadow.blocks);
+    free(rep->shadow.newer);
+    free(rep->shadow.older);
+    free(rep->shadow.chain);
+    free(rep->shadow.buckets);
+    free(rep);
+}
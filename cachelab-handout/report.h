@@ -0,0 +1,49 @@
+/*
+ * report.h - Miss attribution for csim -a
+ *
+ * Every access is charged to its cache set, its 4 KB page and any named
+ * address ranges that contain it. Misses are also classified with the
+ * three Cs: compulsory (first touch of the block), conflict (a fully
+ * associative LRU cache with the same number of lines would have hit) or
+ * capacity (it would have missed too).
+ */
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+#include "traceio.h"
+
+#define REPORT_PAGE_BITS 12
+#define REPORT_MAX_RANGES 16
+
+typedef struct report report_t;
+
+/*
+ * reportCreate - Attribute accesses to a cache with 2^setBits sets of
+ *     2^blockBits-byte blocks and numLines lines in all. Returns NULL if
+ *     out of memory.
+ */
+report_t* reportCreate(int setBits, int blockBits, addr_t numLines);
+
+/*
+ * reportAddRange - Add a range given as <name>:<start>-<end> (hex byte
+ *     addresses, end exclusive). Returns 0, or -1 if spec is malformed or
+ *     there are already REPORT_MAX_RANGES ranges.
+ */
+int reportAddRange(report_t* rep, const char* spec);
+
+/*
+ * reportAccess - Charge one access to addr whose result in the simulated
+ *     cache was result (0 hit, 1 miss, 2 miss eviction). Returns 0, or -1
+ *     if out of memory.
+ */
+int reportAccess(report_t* rep, addr_t addr, int result);
+
+/* reportPrint - Write the per-set, per-page, per-range and total tables */
+void reportPrint(report_t* rep, FILE* out);
+
+/* reportFree - Release everything */
+void reportFree(report_t* rep);
+
+#endif /* REPORT_H */
@@ -0,0 +1,287 @@
+/*
+ * sample.c - Set sampling and time sampling of one cache
+ *
+ * Set sampling draws its sets with Floyd's algorithm, so every subset of
+ * the requested size is equally likely, and numbers them 0..n-1 in a small
+ * cache_t of its own; an addr_map_t (cachesim.h) maps a global set index
+ * to its local one. Sampled sets are seeded as their global index, so under
+ * the random policies too each behaves exactly as in a full run. Hits,
+ * misses and evictions are counted per sampled set.
+ *
+ * Time sampling runs a cachesim_t on the warmup and measurement parts of
+ * each period and leaves the cache as it was across the skipped part. Each
+ * measurement window contributes the change in the totals over it; a
+ * window the trace ends inside is dropped.
+ */
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sample.h"
+
+#define Z_95 1.96
+
+typedef enum sample_kind {
+    SAMPLE_SETS,
+    SAMPLE_TIME
+} sample_kind_t;
+
+struct sampler {
+    sample_kind_t kind;
+    unsigned long fed;          // accesses fed, a modify counting twice
+    unsigned long simulated;    // of those, accesses simulated
+
+    // Set sampling
+    cache_t cache;              // numSets sets, local set i simulates global sets[i]
+    int blockBits;
+    int setBits;
+    addr_t setMask;
+    addr_t* sets;
+    unsigned long numSets;
+    addr_map_t setIndex;        // global set -> local set
+    unsigned long* setHits;     // per local set
+    unsigned long* setMisses;
+    unsigned long* setEvictions;
+
+    // Time sampling
+    cachesim_t sim;
+    unsigned long skip, warmup, measure;
+    unsigned long pos;          // records into the current period
+    unsigned long records;      // records fed
+    unsigned long startHits, startMisses, startEvictions;  // totals when the window opened
+    unsigned long windows;
+    double sum[3], sumSq[3];    // over windows: hits, misses, evictions
+};
+
+
+/* Samples global set set as the next local set; returns -1 if out of memory */
+static int addSet(sampler_t* sp, addr_t set) {
+    int local = sp->numSets;
+    if (mapFindOrAdd(&sp->setIndex, set, &local) < 0) {
+        return -1;
+    }
+    sp->sets[sp->numSets] = set;
+    sp->numSets += 1;
+    return 0;
+}
+
+
+static inline uint64_t splitMix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+
+sampler_t* samplerCreateSets(int setBits, int associativity, int blockBits, policy_t policy,
+                             unsigned long numSets, uint64_t seed) {
+    if (setBits < 0 || setBits > 32 || blockBits < 0 || setBits + blockBits > 64 || numSets == 0) {
+        return NULL;
+    }
+    addr_t totalSets = (addr_t) 1 << setBits;
+    if (numSets > totalSets) {
+        numSets = totalSets;
+    }
+    if (numSets > INT_MAX) {
+        return NULL;
+    }
+    sampler_t* sp = calloc(1, sizeof(sampler_t));
+    if (sp == NULL) {
+        return NULL;
+    }
+    sp->kind = SAMPLE_SETS;
+    sp->setBits = setBits;
+    sp->blockBits = blockBits;
+    sp->setMask = totalSets - 1;
+    sp->sets = malloc(numSets * sizeof(addr_t));
+    sp->setHits = calloc(numSets, sizeof(unsigned long));
+    sp->setMisses = calloc(numSets, sizeof(unsigned long));
+    sp->setEvictions = calloc(numSets, sizeof(unsigned long));
+    if (mapInit(&sp->setIndex, numSets) < 0 || sp->sets == NULL || sp->setHits == NULL ||
+        sp->setMisses == NULL || sp->setEvictions == NULL) {
+        samplerFree(sp);
+        return NULL;
+    }
+    if (initCache(&sp->cache, numSets, associativity, policy) < 0) {
+        samplerFree(sp);
+        return NULL;
+    }
+
+    // Floyd: for each j of the last numSets indexes, take a random t <= j,
+    // or j itself if t is already taken
+    uint64_t state = seed;
+    for (addr_t j = totalSets - numSets; j < totalSets; j += 1) {
+        addr_t t = splitMix64(&state) % (j + 1);
+        if (addSet(sp, mapFind(&sp->setIndex, t) < 0 ? t : j) < 0) {
+            samplerFree(sp);
+            return NULL;
+        }
+    }
+    for (unsigned long i = 0; i < numSets; i += 1) {
+        seedSet(&sp->cache, i, sp->sets[i]);
+    }
+    return sp;
+}
+
+
+sampler_t* samplerCreateTime(int setBits, int associativity, int blockBits, policy_t policy,
+                             unsigned long skip, unsigned long warmup, unsigned long measure) {
+    if (measure == 0) {
+        return NULL;
+    }
+    sampler_t* sp = calloc(1, sizeof(sampler_t));
+    if (sp == NULL) {
+        return NULL;
+    }
+    sp->kind = SAMPLE_TIME;
+    sp->skip = skip;
+    sp->warmup = warmup;
+    sp->measure = measure;
+    if (cacheSimInit(&sp->sim, setBits, associativity, blockBits, policy) < 0) {
+        free(sp);
+        return NULL;
+    }
+    return sp;
+}
+
+
+static void setAccess(sampler_t* sp, addr_t addr, bool isModify) {
+    addr_t block = (sp->blockBits < 64) ? addr >> sp->blockBits : 0;
+    int setI = mapFind(&sp->setIndex, block & sp->setMask);
+
+    sp->fed += 1 + isModify;
+    if (setI < 0) {
+        return;
+    }
+    for (int i = 0; i <= isModify; i += 1) {
+        int result = load(&sp->cache, setI, block >> sp->setBits);
+        if (result == 0) {
+            sp->setHits[setI] += 1;
+        } else {
+            sp->setMisses[setI] += 1;
+            sp->setEvictions[setI] += (result == 2);
+        }
+        sp->simulated += 1;
+    }
+}
+
+
+static void timeAccess(sampler_t* sp, addr_t addr, bool isModify) {
+    cachesim_t* sim = &sp->sim;
+    unsigned long measureStart = sp->skip + sp->warmup;
+
+    sp->fed += 1 + isModify;
+    sp->records += 1;
+    if (sp->pos == measureStart) {
+        sp->startHits = sim->hits;
+        sp->startMisses = sim->misses;
+        sp->startEvictions = sim->evictions;
+    }
+    if (sp->pos >= sp->skip) {
+        sp->simulated += 1 + isModify;
+        cacheSimAccess(sim, addr);
+        if (isModify) {
+            cacheSimAccess(sim, addr);
+        }
+    }
+    sp->pos += 1;
+    if (sp->pos == measureStart + sp->measure) {
+        double counts[3] = {sim->hits - sp->startHits, sim->misses - sp->startMisses,
+                            sim->evictions - sp->startEvictions};
+        for (int i = 0; i < 3; i += 1) {
+            sp->sum[i] += counts[i];
+            sp->sumSq[i] += counts[i] * counts[i];
+        }
+        sp->windows += 1;
+        sp->pos = 0;
+    }
+}
+
+
+void samplerAccess(sampler_t* sampler, addr_t addr, bool isModify) {
+    if (sampler->kind == SAMPLE_SETS) {
+        setAccess(sampler, addr, isModify);
+    } else {
+        timeAccess(sampler, addr, isModify);
+    }
+}
+
+
+/*
+Scales the mean of n samples up to a population of size population, with
+the 95% interval of the total: sd / sqrt(n) for the mean, shrunk by the
+finite population correction, times population.
+*/
+static estimate_t total(double sum, double sumSq, unsigned long n, double population) {
+    estimate_t est = {0.0, 0.0};
+    if (n == 0) {
+        return est;
+    }
+    double mean = sum / n;
+    est.value = mean * population;
+    if (n >= 2) {
+        double var = (sumSq - sum * mean) / (n - 1);
+        double fpc = 1.0 - n / population;
+        if (var > 0 && fpc > 0) {
+            est.halfWidth = Z_95 * population * sqrt(var / n * fpc);
+        }
+    }
+    return est;
+}
+
+
+unsigned long samplerEstimate(sampler_t* sampler, estimate_t* hits, estimate_t* misses, estimate_t* evictions) {
+    double sum[3] = {0, 0, 0}, sumSq[3] = {0, 0, 0};   // hits, misses, evictions
+    unsigned long n;
+    double population;
+
+    if (sampler->kind == SAMPLE_SETS) {
+        for (unsigned long i = 0; i < sampler->numSets; i += 1) {
+            double counts[3] = {sampler->setHits[i], sampler->setMisses[i], sampler->setEvictions[i]};
+            for (int k = 0; k < 3; k += 1) {
+                sum[k] += counts[k];
+                sumSq[k] += counts[k] * counts[k];
+            }
+        }
+        n = sampler->numSets;
+        population = (double) ((addr_t) 1 << sampler->setBits);
+    } else {
+        memcpy(sum, sampler->sum, sizeof(sum));
+        memcpy(sumSq, sampler->sumSq, sizeof(sumSq));
+        n = sampler->windows;
+        population = (double) sampler->records / sampler->measure;
+    }
+    // The number of accesses is known exactly, and hits are dominated by
+    // whichever few sets or phases are hottest, so they are estimated as
+    // accesses minus misses rather than scaled up themselves
+    *misses = total(sum[1], sumSq[1], n, population);
+    *evictions = total(sum[2], sumSq[2], n, population);
+    hits->value = n ? sampler->fed - misses->value : 0.0;
+    hits->halfWidth = misses->halfWidth;
+    return n;
+}
+
+
+double samplerFraction(sampler_t* sampler) {
+    return sampler->fed ? (double) sampler->simulated / sampler->fed : 0.0;
+}
+
+
+void samplerFree(sampler_t* sampler) {
+    if (sampler == NULL) {
+        return;
+    }
+    if (sampler->kind == SAMPLE_SETS) {
+        freeCache(&sampler->cache);
+    } else {
+        cacheSimFree(&sampler->sim);
+    }
+    free(sampler->sets);
+    mapFree(&sampler->setIndex);
+    free(sampler->setHits);
+    free(sampler->setMisses);
+    free(sampler->setEvictions);
+    free(sampler);
+}
@@ -0,0 +1,62 @@
+/*
+ * sample.h - Estimating csim's totals from part of a huge trace
+ *
+ * Set sampling simulates a random subset of the sets. Sets never interact,
+ * so each sampled set sees exactly the accesses, and has exactly the hits,
+ * misses and evictions, it would in the full cache; the totals are
+ * estimated from the per-set mean. Time sampling simulates the whole cache
+ * but only part of the trace: it repeatedly skips some records, simulates
+ * some more to warm the cache up again, then simulates and counts a
+ * measurement window. The totals are estimated from the per-window mean.
+ *
+ * Either way the estimate comes with a 95% confidence interval from the
+ * spread of the samples, using the normal approximation and the finite
+ * population correction.
+ */
+
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stdint.h>
+#include "cachesim.h"
+
+typedef struct estimate {
+    double value;
+    double halfWidth;   // 95% confidence interval is value +- halfWidth
+} estimate_t;
+
+typedef struct sampler sampler_t;
+
+/*
+ * samplerCreateSets - Simulate numSets of the 2^setBits sets, picked
+ *     uniformly at random from seed (setBits at most 32; numSets is capped
+ *     at 2^setBits). Returns NULL if out of memory.
+ */
+sampler_t* samplerCreateSets(int setBits, int associativity, int blockBits, policy_t policy,
+                             unsigned long numSets, uint64_t seed);
+
+/*
+ * samplerCreateTime - Simulate the whole cache, skipping skip records,
+ *     warming up on warmup and counting measure, over and over. Returns
+ *     NULL if out of memory or measure is 0.
+ */
+sampler_t* samplerCreateTime(int setBits, int associativity, int blockBits, policy_t policy,
+                             unsigned long skip, unsigned long warmup, unsigned long measure);
+
+/* samplerAccess - Feed one trace record: a load or store, or a modify (isModify) */
+void samplerAccess(sampler_t* sampler, addr_t addr, bool isModify);
+
+/*
+ * samplerEstimate - Estimated totals over the records fed so far. Returns
+ *     the number of samples (sets, or complete measurement windows) they
+ *     rest on; with fewer than 2 the half-widths are 0 and meaningless.
+ */
+unsigned long samplerEstimate(sampler_t* sampler, estimate_t* hits, estimate_t* misses, estimate_t* evictions);
+
+/* samplerFraction - The fraction of accesses fed so far that were simulated */
+double samplerFraction(sampler_t* sampler);
+
+/* samplerFree - Release everything */
+void samplerFree(sampler_t* sampler);
+
+#endif /* SAMPLE_H */
@@ -0,0 +1,367 @@
+/*
+ * schedule.c - Interpreting and generating transpose schedules
+ *
+ * runSchedule and emitSchedule must stay in step: for every schedule the
+ * emitted function performs the same loads and stores of A and B in the
+ * same order as the interpreter, so that the misses test-trans -G measured
+ * are the misses of the generated code.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include "schedule.h"
+
+char* schedKindNames[NUM_SCHED_KINDS] = {"plain", "staged", "halves"};
+
+
+static inline int minInt(int a, int b) {
+    return a < b ? a : b;
+}
+
+
+static void plainTile(const schedule_t* sched, int M, int N, int A[N][M], int B[M][N], int i, int j) {
+    int iEnd = minInt(i + sched->rows, N);
+    int jEnd = minInt(j + sched->cols, M);
+    int diag = 0;
+
+    if (!sched->colInner) {
+        for (int i1 = i; i1 < iEnd; i1 += 1) {
+            for (int j1 = j; j1 < jEnd; j1 += 1) {
+                if (sched->deferDiag && i1 == j1) {
+                    diag = A[i1][j1];
+                } else {
+                    B[j1][i1] = A[i1][j1];
+                }
+            }
+            if (sched->deferDiag && i1 >= j && i1 < jEnd) {
+                B[i1][i1] = diag;
+            }
+        }
+    } else {
+        for (int j1 = j; j1 < jEnd; j1 += 1) {
+            for (int i1 = i; i1 < iEnd; i1 += 1) {
+                if (sched->deferDiag && i1 == j1) {
+                    diag = A[i1][j1];
+                } else {
+                    B[j1][i1] = A[i1][j1];
+                }
+            }
+            if (sched->deferDiag && j1 >= i && j1 < iEnd) {
+                B[j1][j1] = diag;
+            }
+        }
+    }
+}
+
+
+/* Full-width tiles stage each row; a tile cut by the right edge is plain */
+static void stagedTile(const schedule_t* sched, int M, int N, int A[N][M], int B[M][N], int i, int j) {
+    int iEnd = minInt(i + sched->rows, N);
+    int t[8];
+
+    for (int i1 = i; i1 < iEnd; i1 += 1) {
+        if (j + sched->cols <= M) {
+            for (int k = 0; k < sched->cols; k += 1) {
+                t[k] = A[i1][j + k];
+            }
+            for (int k = 0; k < sched->cols; k += 1) {
+                B[j + k][i1] = t[k];
+            }
+        } else {
+            for (int j1 = j; j1 < M; j1 += 1) {
+                B[j1][i1] = A[i1][j1];
+            }
+        }
+    }
+}
+
+
+/* The tile body of transpose_halves in trans.c */
+static void halvesTile(int M, int N, int A[N][M], int B[M][N], int i, int j) {
+    int t0, t1, t2, t3, t4, t5, t6, t7;
+
+    for (int k = i; k < i + 4; k += 1) {
+        t0 = A[k][j];
+        t1 = A[k][j + 1];
+        t2 = A[k][j + 2];
+        t3 = A[k][j + 3];
+        t4 = A[k][j + 4];
+        t5 = A[k][j + 5];
+        t6 = A[k][j + 6];
+        t7 = A[k][j + 7];
+        B[j][k] = t0;
+        B[j + 1][k] = t1;
+        B[j + 2][k] = t2;
+        B[j + 3][k] = t3;
+        B[j][k + 4] = t4;
+        B[j + 1][k + 4] = t5;
+        B[j + 2][k + 4] = t6;
+        B[j + 3][k + 4] = t7;
+    }
+    for (int k = j; k < j + 4; k += 1) {
+        t0 = A[i + 4][k];
+        t1 = A[i + 5][k];
+        t2 = A[i + 6][k];
+        t3 = A[i + 7][k];
+        t4 = B[k][i + 4];
+        t5 = B[k][i + 5];
+        t6 = B[k][i + 6];
+        t7 = B[k][i + 7];
+        B[k][i + 4] = t0;
+        B[k][i + 5] = t1;
+        B[k][i + 6] = t2;
+        B[k][i + 7] = t3;
+        B[k + 4][i] = t4;
+        B[k + 4][i + 1] = t5;
+        B[k + 4][i + 2] = t6;
+        B[k + 4][i + 3] = t7;
+    }
+    for (int k = j + 4; k < j + 8; k += 1) {
+        t0 = A[i + 4][k];
+        t1 = A[i + 5][k];
+        t2 = A[i + 6][k];
+        t3 = A[i + 7][k];
+        B[k][i + 4] = t0;
+        B[k][i + 5] = t1;
+        B[k][i + 6] = t2;
+        B[k][i + 7] = t3;
+    }
+}
+
+
+static void runTile(const schedule_t* sched, int M, int N, int A[N][M], int B[M][N], int i, int j) {
+    switch (sched->kind) {
+        case SCHED_PLAIN:
+            plainTile(sched, M, N, A, B, i, j);
+            break;
+        case SCHED_STAGED:
+            stagedTile(sched, M, N, A, B, i, j);
+            break;
+        default:
+            halvesTile(M, N, A, B, i, j);
+            break;
+    }
+}
+
+
+void runSchedule(const schedule_t* sched, int M, int N, int A[N][M], int B[M][N]) {
+    bool halves = sched->kind == SCHED_HALVES;
+    int rows = halves ? 8 : sched->rows;
+    int cols = halves ? 8 : sched->cols;
+    int iLimit = halves ? N - N % 8 : N;
+    int jLimit = halves ? M - M % 8 : M;
+
+    if (!sched->colTiles) {
+        for (int i = 0; i < iLimit; i += rows) {
+            for (int j = 0; j < jLimit; j += cols) {
+                runTile(sched, M, N, A, B, i, j);
+            }
+        }
+    } else {
+        for (int j = 0; j < jLimit; j += cols) {
+            for (int i = 0; i < iLimit; i += rows) {
+                runTile(sched, M, N, A, B, i, j);
+            }
+        }
+    }
+    if (halves) {
+        // As transpose_edges: the right strip, then the bottom strip
+        for (int i = 0; i < N; i += 1) {
+            for (int j = jLimit; j < M; j += 1) {
+                B[j][i] = A[i][j];
+            }
+        }
+        for (int i = iLimit; i < N; i += 1) {
+            for (int j = 0; j < jLimit; j += 1) {
+                B[j][i] = A[i][j];
+            }
+        }
+    }
+}
+
+
+void describeSchedule(const schedule_t* sched, char* buf, int size) {
+    if (sched->kind == SCHED_HALVES) {
+        snprintf(buf, size, "halves 8 x 8, %s tiles", sched->colTiles ? "column" : "row");
+    } else if (sched->kind == SCHED_STAGED) {
+        snprintf(buf, size, "staged %d x %d, %s tiles", sched->rows, sched->cols,
+                 sched->colTiles ? "column" : "row");
+    } else {
+        snprintf(buf, size, "plain %d x %d, %s tiles, by %s%s", sched->rows, sched->cols,
+                 sched->colTiles ? "column" : "row", sched->colInner ? "columns" : "rows",
+                 sched->deferDiag ? ", diagonal deferred" : "");
+    }
+}
+
+
+/* Writes one line of generated code, indented depth levels */
+static void emit(FILE* fp, int depth, const char* fmt, ...) {
+    va_list args;
+
+    fprintf(fp, "%*s", depth * 4, "");
+    va_start(args, fmt);
+    vfprintf(fp, fmt, args);
+    va_end(args);
+    fputc('\n', fp);
+}
+
+
+static void emitPlainTile(FILE* fp, const schedule_t* sched, int d) {
+    int R = sched->rows, C = sched->cols;
+    const char* rowLoop = "for (i1 = i; i1 < i + %d && i1 < N; i1++) {";
+    const char* colLoop = "for (j1 = j; j1 < j + %d && j1 < M; j1++) {";
+
+    emit(fp, d, sched->colInner ? colLoop : rowLoop, sched->colInner ? C : R);
+    emit(fp, d + 1, sched->colInner ? rowLoop : colLoop, sched->colInner ? R : C);
+    if (sched->deferDiag) {
+        emit(fp, d + 2, "if (i1 == j1) {");
+        emit(fp, d + 3, "diag = A[i1][j1];");
+        emit(fp, d + 2, "} else {");
+        emit(fp, d + 3, "B[j1][i1] = A[i1][j1];");
+        emit(fp, d + 2, "}");
+    } else {
+        emit(fp, d + 2, "B[j1][i1] = A[i1][j1];");
+    }
+    emit(fp, d + 1, "}");
+    if (sched->deferDiag && !sched->colInner) {
+        emit(fp, d + 1, "if (i1 >= j && i1 < j + %d && i1 < M) {", C);
+        emit(fp, d + 2, "B[i1][i1] = diag;");
+        emit(fp, d + 1, "}");
+    } else if (sched->deferDiag) {
+        emit(fp, d + 1, "if (j1 >= i && j1 < i + %d && j1 < N) {", R);
+        emit(fp, d + 2, "B[j1][j1] = diag;");
+        emit(fp, d + 1, "}");
+    }
+    emit(fp, d, "}");
+}
+
+
+static void emitStagedTile(FILE* fp, const schedule_t* sched, int d) {
+    int R = sched->rows, C = sched->cols;
+
+    emit(fp, d, "for (i1 = i; i1 < i + %d && i1 < N; i1++) {", R);
+    emit(fp, d + 1, "if (j + %d <= M) {", C);
+    emit(fp, d + 2, "t0 = A[i1][j];");
+    for (int k = 1; k < C; k += 1) {
+        emit(fp, d + 2, "t%d = A[i1][j + %d];", k, k);
+    }
+    emit(fp, d + 2, "B[j][i1] = t0;");
+    for (int k = 1; k < C; k += 1) {
+        emit(fp, d + 2, "B[j + %d][i1] = t%d;", k, k);
+    }
+    emit(fp, d + 1, "} else {");
+    emit(fp, d + 2, "for (j1 = j; j1 < M; j1++) {");
+    emit(fp, d + 3, "B[j1][i1] = A[i1][j1];");
+    emit(fp, d + 2, "}");
+    emit(fp, d + 1, "}");
+    emit(fp, d, "}");
+}
+
+
+static void emitHalvesTile(FILE* fp, int d) {
+    static const char* body[] = {
+        "for (k = i; k < i + 4; k++) {",
+        "    t0 = A[k][j];",
+        "    t1 = A[k][j + 1];",
+        "    t2 = A[k][j + 2];",
+        "    t3 = A[k][j + 3];",
+        "    t4 = A[k][j + 4];",
+        "    t5 = A[k][j + 5];",
+        "    t6 = A[k][j + 6];",
+        "    t7 = A[k][j + 7];",
+        "    B[j][k] = t0;",
+        "    B[j + 1][k] = t1;",
+        "    B[j + 2][k] = t2;",
+        "    B[j + 3][k] = t3;",
+        "    B[j][k + 4] = t4;",
+        "    B[j + 1][k + 4] = t5;",
+        "    B[j + 2][k + 4] = t6;",
+        "    B[j + 3][k + 4] = t7;",
+        "}",
+        "for (k = j; k < j + 4; k++) {",
+        "    t0 = A[i + 4][k];",
+        "    t1 = A[i + 5][k];",
+        "    t2 = A[i + 6][k];",
+        "    t3 = A[i + 7][k];",
+        "    t4 = B[k][i + 4];",
+        "    t5 = B[k][i + 5];",
+        "    t6 = B[k][i + 6];",
+        "    t7 = B[k][i + 7];",
+        "    B[k][i + 4] = t0;",
+        "    B[k][i + 5] = t1;",
+        "    B[k][i + 6] = t2;",
+        "    B[k][i + 7] = t3;",
+        "    B[k + 4][i] = t4;",
+        "    B[k + 4][i + 1] = t5;",
+        "    B[k + 4][i + 2] = t6;",
+        "    B[k + 4][i + 3] = t7;",
+        "}",
+        "for (k = j + 4; k < j + 8; k++) {",
+        "    t0 = A[i + 4][k];",
+        "    t1 = A[i + 5][k];",
+        "    t2 = A[i + 6][k];",
+        "    t3 = A[i + 7][k];",
+        "    B[k][i + 4] = t0;",
+        "    B[k][i + 5] = t1;",
+        "    B[k][i + 6] = t2;",
+        "    B[k][i + 7] = t3;",
+        "}",
+    };
+
+    for (int k = 0; k < sizeof(body) / sizeof(body[0]); k += 1) {
+        emit(fp, d, "%s", body[k]);
+    }
+}
+
+
+void emitSchedule(FILE* fp, const char* name, const schedule_t* sched) {
+    bool halves = sched->kind == SCHED_HALVES;
+    const char* rowLoop = halves ? "for (i = 0; i + 8 <= N; i += 8) {" : "for (i = 0; i < N; i += %d) {";
+    const char* colLoop = halves ? "for (j = 0; j + 8 <= M; j += 8) {" : "for (j = 0; j < M; j += %d) {";
+
+    emit(fp, 0, "static void %s(int M, int N, int A[N][M], int B[M][N])", name);
+    emit(fp, 0, "{");
+    switch (sched->kind) {
+        case SCHED_PLAIN:
+            emit(fp, 1, sched->deferDiag ? "int i, j, i1, j1, diag = 0;" : "int i, j, i1, j1;");
+            break;
+        case SCHED_STAGED:
+            fprintf(fp, "    int i, j, i1, j1");
+            for (int k = 0; k < sched->cols; k += 1) {
+                fprintf(fp, ", t%d", k);
+            }
+            fprintf(fp, ";\n");
+            break;
+        default:
+            emit(fp, 1, "int i, j, k, t0, t1, t2, t3, t4, t5, t6, t7;");
+            break;
+    }
+    emit(fp, 0, "");
+    emit(fp, 1, sched->colTiles ? colLoop : rowLoop, sched->colTiles ? sched->cols : sched->rows);
+    emit(fp, 2, sched->colTiles ? rowLoop : colLoop, sched->colTiles ? sched->rows : sched->cols);
+    switch (sched->kind) {
+        case SCHED_PLAIN:
+            emitPlainTile(fp, sched, 3);
+            break;
+        case SCHED_STAGED:
+            emitStagedTile(fp, sched, 3);
+            break;
+        default:
+            emitHalvesTile(fp, 3);
+            break;
+    }
+    emit(fp, 2, "}");
+    emit(fp, 1, "}");
+    if (halves) {
+        emit(fp, 1, "for (i = 0; i < N; i++) {");
+        emit(fp, 2, "for (j = M - M %% 8; j < M; j++) {");
+        emit(fp, 3, "B[j][i] = A[i][j];");
+        emit(fp, 2, "}");
+        emit(fp, 1, "}");
+        emit(fp, 1, "for (i = N - N %% 8; i < N; i++) {");
+        emit(fp, 2, "for (j = 0; j < M - M %% 8; j++) {");
+        emit(fp, 3, "B[j][i] = A[i][j];");
+        emit(fp, 2, "}");
+        emit(fp, 1, "}");
+    }
+    emit(fp, 0, "}");
+}
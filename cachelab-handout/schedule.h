@@ -0,0 +1,50 @@
+/*
+ * schedule.h - A parameterized family of transpose schedules
+ *
+ * A schedule fixes how B = A^T is walked: the tile size, the order of the
+ * tiles and of the elements inside one, what happens on the diagonal, and
+ * whether rows of A are staged in locals first. runSchedule interprets a
+ * schedule; emitSchedule writes the same schedule out as a C function with
+ * the identical sequence of loads and stores, so test-trans -G can tune on
+ * the interpreter and generate trans-tuned.c from the winners.
+ */
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef enum sched_kind {
+    SCHED_PLAIN,     // element by element
+    SCHED_STAGED,    // each tile row of A read into locals (cols <= 8), then written
+    SCHED_HALVES,    // 8 x 8 tiles moved as 4 x 4 quarters, as transpose_halves
+    NUM_SCHED_KINDS
+} sched_kind_t;
+
+extern char* schedKindNames[NUM_SCHED_KINDS];
+
+typedef struct schedule {
+    sched_kind_t kind;
+    int rows, cols;     // tile size; halves is always 8 x 8
+    bool colTiles;      // visit tiles column by column rather than row by row
+    bool colInner;      // plain: walk each tile by columns of A rather than rows
+    bool deferDiag;     // plain: write the diagonal after the rest of its row (column)
+} schedule_t;
+
+/*
+ * runSchedule - Transpose the N x M matrix A into B following sched. Full
+ *     8 x 8 tiles only for halves; the rest is transposed element by element.
+ */
+void runSchedule(const schedule_t* sched, int M, int N, int A[N][M], int B[M][N]);
+
+/* describeSchedule - One line summary of sched, e.g. "plain 8 x 4, row tiles" */
+void describeSchedule(const schedule_t* sched, char* buf, int size);
+
+/*
+ * emitSchedule - Write sched as a static C function called name, with the
+ *     usual trans.c prototype and the same accesses as runSchedule
+ */
+void emitSchedule(FILE* fp, const char* name, const schedule_t* sched);
+
+#endif /* SCHEDULE_H */
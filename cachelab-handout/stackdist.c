@@ -0,0 +1,326 @@
+/*
+ * stackdist.c - Mattson stack distances for every set count in one pass
+ *
+ * Each distinct block gets a dense index on first touch (an addr_map_t
+ * from block number to index) and remembers the time of its last access. For
+ * every set count there is one treap per set, keyed by last-access time and
+ * holding one node per block that maps to the set. The stack distance of an
+ * access is then the number of nodes in its set's treap with a later time;
+ * the block's node is cut out and merged back as the newest, all in
+ * expected O(log n). Node storage is indexed by block, one array per field
+ * per level, so nothing is allocated per access.
+ *
+ * Cold accesses and distances >= maxAssoc are both misses for every tracked
+ * E and share the last histogram bucket. Evictions are misses that found
+ * the set full; an LRU set only ever fills up, so a set ends up with
+ * min(E, distinct blocks) fills and the rest of its misses evicted.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "cachesim.h"
+#include "stackdist.h"
+
+typedef struct level {
+    int* root;              // per set: treap root, -1 if the set is empty
+    int* mru;               // per set: block touched last, -1 if the set is empty
+    int* left;              // per block: treap children and subtree size
+    int* right;
+    int* size;
+    unsigned long* hist;    // hist[d]: accesses at distance d, d == maxAssoc for >=/cold
+    unsigned long* fills;   // fills[E-1]: sum over sets of min(E, blocks in set)
+} level_t;
+
+struct stackdist {
+    int blockBits;
+    int maxSetBits;
+    int maxAssoc;
+    level_t* levels;        // one per set count, levels[s] has 2^s sets
+    bool countsReady;       // fills[] are up to date
+
+    // Per distinct block
+    addr_map_t index;       // block number -> index into the arrays below
+    uint64_t* lastTime;
+    uint32_t* prio;         // treap heap priority
+    int numBlocks;
+    int blockCap;
+    uint32_t rng;
+
+    uint64_t now;
+};
+
+
+stackdist_t* stackDistCreate(int blockBits, int maxSetBits, int maxAssoc) {
+    if (blockBits < 0 || blockBits > 63 || maxSetBits < 0 ||
+        maxSetBits > STACKDIST_MAX_SET_BITS || maxSetBits + blockBits > 64 || maxAssoc < 1) {
+        return NULL;
+    }
+    stackdist_t* sd = calloc(1, sizeof(stackdist_t));
+    if (sd == NULL) {
+        return NULL;
+    }
+    sd->blockBits = blockBits;
+    sd->maxSetBits = maxSetBits;
+    sd->maxAssoc = maxAssoc;
+    sd->rng = 0x2545F491;
+    sd->levels = calloc(maxSetBits + 1, sizeof(level_t));
+    if (mapInit(&sd->index, 512) < 0 || sd->levels == NULL) {
+        stackDistFree(sd);
+        return NULL;
+    }
+    for (int s = 0; s <= maxSetBits; s += 1) {
+        level_t* lvl = &sd->levels[s];
+        size_t numSets = (size_t) 1 << s;
+        lvl->root = malloc(numSets * sizeof(int));
+        lvl->mru = malloc(numSets * sizeof(int));
+        lvl->hist = calloc(maxAssoc + 1, sizeof(unsigned long));
+        lvl->fills = calloc(maxAssoc, sizeof(unsigned long));
+        if (lvl->root == NULL || lvl->mru == NULL || lvl->hist == NULL || lvl->fills == NULL) {
+            stackDistFree(sd);
+            return NULL;
+        }
+        memset(lvl->root, -1, numSets * sizeof(int));
+        memset(lvl->mru, -1, numSets * sizeof(int));
+    }
+    return sd;
+}
+
+
+/* Doubles the per-block arrays */
+static int growBlocks(stackdist_t* sd) {
+    int cap = sd->blockCap ? sd->blockCap * 2 : 4096;
+    uint64_t* lastTime = realloc(sd->lastTime, cap * sizeof(uint64_t));
+    if (lastTime == NULL) {
+        return -1;
+    }
+    sd->lastTime = lastTime;
+    uint32_t* prio = realloc(sd->prio, cap * sizeof(uint32_t));
+    if (prio == NULL) {
+        return -1;
+    }
+    sd->prio = prio;
+    for (int s = 0; s <= sd->maxSetBits; s += 1) {
+        level_t* lvl = &sd->levels[s];
+        int** fields[3] = {&lvl->left, &lvl->right, &lvl->size};
+        for (int f = 0; f < 3; f += 1) {
+            int* field = realloc(*fields[f], cap * sizeof(int));
+            if (field == NULL) {
+                return -1;
+            }
+            *fields[f] = field;
+        }
+    }
+    sd->blockCap = cap;
+    return 0;
+}
+
+
+static inline int nodeSize(const level_t* lvl, int n) {
+    return n < 0 ? 0 : lvl->size[n];
+}
+
+
+static inline void update(level_t* lvl, int n) {
+    lvl->size[n] = 1 + nodeSize(lvl, lvl->left[n]) + nodeSize(lvl, lvl->right[n]);
+}
+
+
+/* Splits the treap at n into keys < t (*l) and keys >= t (*r) */
+static void split(stackdist_t* sd, level_t* lvl, int n, uint64_t t, int* l, int* r) {
+    if (n < 0) {
+        *l = *r = -1;
+    } else if (sd->lastTime[n] < t) {
+        split(sd, lvl, lvl->right[n], t, &lvl->right[n], r);
+        *l = n;
+        update(lvl, n);
+    } else {
+        split(sd, lvl, lvl->left[n], t, l, &lvl->left[n]);
+        *r = n;
+        update(lvl, n);
+    }
+}
+
+
+/* Joins treaps a and b, every key of a being smaller than every key of b */
+static int merge(stackdist_t* sd, level_t* lvl, int a, int b) {
+    if (a < 0) {
+        return b;
+    }
+    if (b < 0) {
+        return a;
+    }
+    if (sd->prio[a] > sd->prio[b]) {
+        lvl->right[a] = merge(sd, lvl, lvl->right[a], b);
+        update(lvl, a);
+        return a;
+    }
+    lvl->left[b] = merge(sd, lvl, a, lvl->left[b]);
+    update(lvl, b);
+    return b;
+}
+
+
+static int removeMin(level_t* lvl, int n) {
+    if (lvl->left[n] < 0) {
+        return lvl->right[n];
+    }
+    lvl->left[n] = removeMin(lvl, lvl->left[n]);
+    update(lvl, n);
+    return n;
+}
+
+
+int stackDistAccess(stackdist_t* sd, addr_t addr) {
+    addr_t block = addr >> sd->blockBits;
+    int maxAssoc = sd->maxAssoc;
+    int idx = sd->numBlocks;
+    int found = mapFindOrAdd(&sd->index, block, &idx);
+
+    sd->countsReady = false;
+    sd->now += 1;
+    if (found < 0) {
+        return -1;
+    }
+    if (!found) {
+        // First touch: a cold miss everywhere, and the newest node of its set
+        if (sd->numBlocks == sd->blockCap && growBlocks(sd) < 0) {
+            return -1;
+        }
+        sd->numBlocks += 1;
+        sd->lastTime[idx] = sd->now;
+        sd->rng ^= sd->rng << 13;
+        sd->rng ^= sd->rng >> 17;
+        sd->rng ^= sd->rng << 5;
+        sd->prio[idx] = sd->rng;
+        for (int s = 0; s <= sd->maxSetBits; s += 1) {
+            level_t* lvl = &sd->levels[s];
+            addr_t setI = block & (((addr_t) 1 << s) - 1);
+            lvl->left[idx] = lvl->right[idx] = -1;
+            lvl->size[idx] = 1;
+            lvl->root[setI] = merge(sd, lvl, lvl->root[setI], idx);
+            lvl->mru[setI] = idx;
+            lvl->hist[maxAssoc] += 1;
+        }
+        return 0;
+    }
+
+    uint64_t t = sd->lastTime[idx];
+    for (int s = 0; s <= sd->maxSetBits; s += 1) {
+        level_t* lvl = &sd->levels[s];
+        addr_t setI = block & (((addr_t) 1 << s) - 1);
+        int older, newer;
+
+        // Re-touching the newest block changes nothing but its time, which
+        // stays the largest key of the set. Sets only get smaller as s
+        // grows, so the block is then also the newest at every finer level.
+        if (lvl->mru[setI] == idx) {
+            for (; s <= sd->maxSetBits; s += 1) {
+                sd->levels[s].hist[0] += 1;
+            }
+            break;
+        }
+        // newer holds this block (its minimum) and every block touched since
+        split(sd, lvl, lvl->root[setI], t, &older, &newer);
+        int dist = lvl->size[newer] - 1;
+        lvl->hist[dist < maxAssoc ? dist : maxAssoc] += 1;
+
+        newer = removeMin(lvl, newer);
+        lvl->left[idx] = lvl->right[idx] = -1;
+        lvl->size[idx] = 1;
+        lvl->root[setI] = merge(sd, lvl, merge(sd, lvl, older, newer), idx);
+        lvl->mru[setI] = idx;
+    }
+    // Only after every level has split on the old time
+    sd->lastTime[idx] = sd->now;
+    return 0;
+}
+
+
+void stackDistRepeat(stackdist_t* sd) {
+    sd->now += 1;
+    for (int s = 0; s <= sd->maxSetBits; s += 1) {
+        sd->levels[s].hist[0] += 1;
+    }
+}
+
+
+/* Tallies, per level, how many lines end up filled for each E */
+static void computeFills(stackdist_t* sd) {
+    int maxAssoc = sd->maxAssoc;
+    unsigned long* numSetsWith = malloc((maxAssoc + 1) * sizeof(unsigned long));
+
+    if (numSetsWith == NULL) {
+        printf("Unable to allocate stack distance counts.\n");
+        exit(1);
+    }
+    for (int s = 0; s <= sd->maxSetBits; s += 1) {
+        level_t* lvl = &sd->levels[s];
+        size_t numSets = (size_t) 1 << s;
+
+        // numSetsWith[k]: sets holding k distinct blocks (k == maxAssoc for >=)
+        memset(numSetsWith, 0, (maxAssoc + 1) * sizeof(unsigned long));
+        for (size_t i = 0; i < numSets; i += 1) {
+            int n = nodeSize(lvl, lvl->root[i]);
+            numSetsWith[n < maxAssoc ? n : maxAssoc] += 1;
+        }
+        // fills(E) = sum_k numSetsWith[k] * min(E, k), built up E by E
+        unsigned long atLeast = 0; // sets with at least E blocks
+        for (int k = 1; k <= maxAssoc; k += 1) {
+            atLeast += numSetsWith[k];
+        }
+        unsigned long fills = 0;
+        for (int e = 1; e <= maxAssoc; e += 1) {
+            fills += atLeast;
+            lvl->fills[e - 1] = fills;
+            atLeast -= numSetsWith[e];
+        }
+    }
+    free(numSetsWith);
+    sd->countsReady = true;
+}
+
+
+void stackDistCounts(stackdist_t* sd, int setBits, int assoc,
+                     unsigned long* hits, unsigned long* misses, unsigned long* evictions) {
+    level_t* lvl = &sd->levels[setBits];
+    unsigned long numHits = 0, total = 0;
+
+    if (!sd->countsReady) {
+        computeFills(sd);
+    }
+    for (int d = 0; d <= sd->maxAssoc; d += 1) {
+        if (d < assoc) {
+            numHits += lvl->hist[d];
+        }
+        total += lvl->hist[d];
+    }
+    *hits = numHits;
+    *misses = total - numHits;
+    *evictions = *misses - lvl->fills[assoc - 1];
+}
+
+
+void stackDistFree(stackdist_t* sd) {
+    if (sd == NULL) {
+        return;
+    }
+    if (sd->levels != NULL) {
+        for (int s = 0; s <= sd->maxSetBits; s += 1) {
+            level_t* lvl = &sd->levels[s];
+            free(lvl->root);
+            free(lvl->mru);
+            free(lvl->left);
+            free(lvl->right);
+            free(lvl->size);
+            free(lvl->hist);
+            free(lvl->fills);
+        }
+        free(sd->levels);
+    }
+    free(sd->lastTime);
+    free(sd->prio);
+    mapFree(&sd->index);
+    free(sd);
+}
@@ -0,0 +1,48 @@
+/*
+ * stackdist.h - Single-pass LRU simulation of many cache geometries
+ *
+ * For a fixed block size, an access hits in an E-way LRU set exactly when
+ * fewer than E distinct blocks of the same set were touched since the last
+ * access to its block (its LRU stack distance). stackdist measures that
+ * distance once per access for every set count 2^0 .. 2^maxSetBits, so one
+ * pass over a trace yields the hits, misses and evictions csim would report
+ * for every (s, E) pair with s <= maxSetBits and E <= maxAssoc.
+ */
+
+#ifndef STACKDIST_H
+#define STACKDIST_H
+
+#include "traceio.h"
+
+#define STACKDIST_MAX_SET_BITS 20
+
+typedef struct stackdist stackdist_t;
+
+/*
+ * stackDistCreate - Track block size 2^blockBits for s = 0..maxSetBits and
+ *     E = 1..maxAssoc. Returns NULL if the arguments are out of range or
+ *     memory runs out.
+ */
+stackdist_t* stackDistCreate(int blockBits, int maxSetBits, int maxAssoc);
+
+/* stackDistAccess - Record one access to addr. Returns 0, or -1 if out of memory. */
+int stackDistAccess(stackdist_t* sd, addr_t addr);
+
+/*
+ * stackDistRepeat - Record an immediate second access to the block of the
+ *     previous stackDistAccess (the store half of a modify), a hit in every
+ *     geometry.
+ */
+void stackDistRepeat(stackdist_t* sd);
+
+/*
+ * stackDistCounts - Hits, misses and evictions of the 2^setBits-set,
+ *     assoc-way LRU cache over the accesses recorded so far.
+ */
+void stackDistCounts(stackdist_t* sd, int setBits, int assoc,
+                     unsigned long* hits, unsigned long* misses, unsigned long* evictions);
+
+/* stackDistFree - Release everything */
+void stackDistFree(stackdist_t* sd);
+
+#endif /* STACKDIST_H */
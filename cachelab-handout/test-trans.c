@@ -3,6 +3,7 @@
  *     student's transpose functions and records the results for their
  *     official submitted version as well.
  */
+#define _DEFAULT_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -11,9 +12,17 @@
 #include <signal.h>
 #include <getopt.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include "cachelab.h"
+#include "traceio.h"
+#include "cachesim.h"
+#include "memhook.h"
+#include "fasttrans.h"
+#include "schedule.h"
+#include "cost.h"
 #include <sys/wait.h> // fir WEXITSTATUS
 #include <limits.h> // for INT_MAX
+#include <time.h>
 
 /* Maximum array dimension */
 #define MAXN 256
@@ -22,16 +31,68 @@
    student submits for credit */
 #define SUBMIT_DESCRIPTION "Transpose submission"
 
-/* External function defined in trans.c */
+/* External functions defined in trans.c, in trans-tuned.c (-G) and in
+   kernels.c (-K) */
 extern void registerFunctions();
+extern void registerTunedFunctions();
+extern void registerKernels();
+extern void transpose_tiled(int M, int N, int A[N][M], int B[M][N], int rows, int cols);
 
 /* External variables defined in cachelab-tools.c */
 extern trans_func_t func_list[MAX_TRANS_FUNCS];
 extern int func_counter; 
+extern kernel_func_t kernel_list[MAX_KERNELS];
+extern int kernel_counter;
+
+/* Trace records decoded per traceRead call */
+#define BATCH_SIZE 4096
 
 /* Globals set on the command line */
 static int M = 0;
 static int N = 0;
+static char* capture_file = NULL; /* previously captured trace of all functions */
+static char* heatmap_prefix = NULL; /* write miss heatmaps to files starting with this */
+static int in_process = 0; /* trace and simulate in-process instead of valgrind (-i) */
+static int sweep = 0; /* evaluate all functions over sweep_shapes (-S) */
+static int bench_mb = 0; /* time the native kernels on matrices up to this size (-B) */
+static int bench_threads = 0; /* time the parallel transpose up to this many threads (-T) */
+static char* tune_file = NULL; /* search schedules and write the winners here as C (-G) */
+static int kernels = 0; /* evaluate the kernels of kernels.c instead of transposes (-K) */
+static char* param_overrides[MAX_KERNEL_PARAMS * 4]; /* name=value, for -K (-P) */
+static int num_overrides = 0;
+
+/* Heatmaps: set-by-time buckets, and pixels per cell side in the images */
+#define HEAT_BUCKETS 64
+#define HEAT_SCALE 8
+
+/* Shapes (M x N) evaluated by -S, and the tile sides it tunes over */
+static const int sweep_shapes[][2] = {
+    {32, 32}, {64, 64}, {61, 67}, {48, 48}, {96, 96}, {100, 37},
+    {37, 100}, {128, 128}, {255, 255}, {256, 256}
+};
+static const int tile_sides[] = {2, 4, 6, 8, 12, 16, 24, 32};
+
+/* In-process evaluation: the matrices, laid out like tracegen's, and
+   stand-ins for its marker bytes */
+static int A[MAXN][MAXN];
+static int B[MAXN][MAXN];
+static char markers[2];
+
+/* One function's evaluation. Its accesses, whether read from a trace or
+   reported by the in-process hooks, are simulated as they arrive, written
+   to trace.f<func>, and with -H, remembered for the heatmaps. */
+struct evaluation {
+    cachesim_t sim;
+    FILE* trace_fp;
+    unsigned long long addrs[5];   /* markers, A, B and the in-place scratch, as in .marker */
+
+    /* Heatmaps: the set and miss count of every access, and the misses
+       per element of A and B */
+    unsigned int* sets;
+    unsigned char* counts;
+    int n, cap;
+    unsigned int *a_misses, *b_misses;
+};
 
 /* The correctness and performance for the submitted transpose function */
 struct results {
@@ -41,22 +102,802 @@ struct results {
 };
 static struct results results = {-1, 0, INT_MAX};
 
+/*
+ * eval_begin - Start evaluating function func on an s/E/b LRU cache, with
+ *     the marker, A, B and scratch addresses in addrs (all but the markers
+ *     may be 0 if unknown).
+ *     A negative func writes no trace file.
+ */
+void eval_begin(struct evaluation* ev, int func, unsigned int s, unsigned int E,
+                unsigned int b, unsigned long long addrs[5])
+{
+    char filename[128];
+
+    memset(ev, 0, sizeof(*ev));
+    memcpy(ev->addrs, addrs, sizeof(ev->addrs));
+    if (cacheSimInit(&ev->sim, s, E, b, POLICY_LRU) < 0) {
+        printf("Unable to allocate cache.\n");
+        exit(1);
+    }
+    if (func >= 0) {
+        sprintf(filename, "trace.f%d", func);
+        ev->trace_fp = fopen(filename, "w");
+        assert(ev->trace_fp);
+    }
+    if (heatmap_prefix) {
+        ev->a_misses = calloc(N * M, sizeof(unsigned int));
+        ev->b_misses = calloc(M * N, sizeof(unsigned int));
+        assert(ev->a_misses && ev->b_misses);
+    }
+}
+
+/*
+ * eval_access - Simulate one access (a modify is a load and a store) and
+ *     append it to the function's trace file
+ */
+void eval_access(struct evaluation* ev, char op, unsigned long long addr, int size)
+{
+    int misses = (cacheSimAccess(&ev->sim, addr) != 0);
+    if (op == 'M')
+        misses += (cacheSimAccess(&ev->sim, addr) != 0);
+    if (ev->trace_fp)
+        fprintf(ev->trace_fp, " %c %08llx,%d\n", op, addr, size);
+
+    if (heatmap_prefix) {
+        unsigned long long a_off = addr - ev->addrs[2];
+        unsigned long long b_off = addr - ev->addrs[3];
+        if (ev->n == ev->cap) {
+            ev->cap = ev->cap ? ev->cap * 2 : 4096;
+            ev->sets = realloc(ev->sets, ev->cap * sizeof(unsigned int));
+            ev->counts = realloc(ev->counts, ev->cap);
+            assert(ev->sets && ev->counts);
+        }
+        ev->sets[ev->n] = (addr >> ev->sim.blockBits) & ev->sim.setMask;
+        ev->counts[ev->n] = misses;
+        ev->n++;
+        if (ev->addrs[2] && a_off < (unsigned long long) N * M * sizeof(int))
+            ev->a_misses[a_off / sizeof(int)] += misses;
+        else if (ev->addrs[3] && b_off < (unsigned long long) M * N * sizeof(int))
+            ev->b_misses[b_off / sizeof(int)] += misses;
+    }
+}
+
+/* eval_end - Close the trace file and free the evaluation */
+void eval_end(struct evaluation* ev)
+{
+    if (ev->trace_fp)
+        fclose(ev->trace_fp);
+    cacheSimFree(&ev->sim);
+    free(ev->sets);
+    free(ev->counts);
+    free(ev->a_misses);
+    free(ev->b_misses);
+}
+
+/*
+ * eval_region - Evaluate the accesses of the region'th marker-bounded
+ *     region (counting from 0) of a text or binary trace.
+ *     Returns 0 on success, -1 if the trace cannot be read or the region
+ *     is missing.
+ */
+int eval_region(char* tracefile, int region, struct evaluation* ev,
+                   unsigned long long marker_start, unsigned long long marker_end)
+{
+    static trace_rec_t recs[BATCH_SIZE];
+    int i, n, flag = 0, found = 0, curr = -1;
+    unsigned long long addr;
+
+    trace_reader_t* reader = traceOpen(tracefile);
+    if (reader == NULL)
+        return -1;
+
+    while (!found && (n = traceRead(reader, recs, BATCH_SIZE)) > 0) {
+        for (i = 0; i < n; i++) {
+            addr = recs[i].addr;
+
+            /* If start marker found, set flag */
+            if (addr == marker_start) {
+                curr++;
+                flag = (curr == region);
+            }
+
+            /* Valgrind creates many spurious accesses to the
+               stack that have nothing to do with the students
+               code. At the moment, we are ignoring all stack
+               accesses by using the simple filter of recording
+               accesses to only the low 32-bit portion of the
+               address space. At some point it would be nice to
+               try to do more informed filtering so that would
+               eliminate the valgrind stack references while
+               include the student stack references. */
+            if (flag && addr < 0xffffffff) {
+                eval_access(ev, recs[i].op, addr, recs[i].size);
+            }
+
+            /* if end marker found, the region is complete */
+            if (flag && addr == marker_end) {
+                found = 1;
+                break;
+            }
+        }
+    }
+    traceClose(reader);
+    if (n < 0) {
+        printf("Error: %s is truncated or corrupt\n", tracefile);
+        exit(1);
+    }
+    return found ? 0 : -1;
+}
+
+/*
+ * write_heatmap - Write a rows x cols grid of miss counts as base.csv and
+ *     as base.ppm, where each cell is a HEAT_SCALE pixel square going from
+ *     black (no misses) through red and yellow to white (the most misses).
+ */
+void write_heatmap(char* base, int rows, int cols, unsigned int* cells)
+{
+    char filename[256];
+    unsigned int max = 1;
+    int r, c, y, x;
+    FILE* fp;
+
+    sprintf(filename, "%s.csv", base);
+    fp = fopen(filename, "w");
+    assert(fp);
+    for (r = 0; r < rows; r++) {
+        for (c = 0; c < cols; c++) {
+            fprintf(fp, c ? ",%u" : "%u", cells[r * cols + c]);
+            if (cells[r * cols + c] > max)
+                max = cells[r * cols + c];
+        }
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+
+    sprintf(filename, "%s.ppm", base);
+    fp = fopen(filename, "wb");
+    assert(fp);
+    fprintf(fp, "P6\n%d %d\n255\n", cols * HEAT_SCALE, rows * HEAT_SCALE);
+    for (r = 0; r < rows; r++) {
+        for (y = 0; y < HEAT_SCALE; y++) {
+            for (c = 0; c < cols; c++) {
+                int v = (int) (765.0 * cells[r * cols + c] / max); /* 0..3*255 */
+                unsigned char rgb[3];
+                rgb[0] = v > 255 ? 255 : v;
+                rgb[1] = v > 510 ? 255 : v > 255 ? v - 255 : 0;
+                rgb[2] = v > 510 ? v - 510 : 0;
+                for (x = 0; x < HEAT_SCALE; x++)
+                    fwrite(rgb, 1, 3, fp);
+            }
+        }
+    }
+    fclose(fp);
+}
+
+/*
+ * write_heatmaps - Write where the misses of function func fell: per
+ *     cache set over HEAT_BUCKETS equal slices of its accesses, and per
+ *     element of A (N x M) and B (M x N) when their addresses are known
+ */
+void write_heatmaps(struct evaluation* ev, int func)
+{
+    unsigned long long num_sets = ev->sim.setMask + 1;
+    unsigned int* set_misses;
+    char base[200];
+    int k;
+
+    set_misses = calloc(num_sets * HEAT_BUCKETS, sizeof(unsigned int));
+    assert(set_misses);
+    for (k = 0; k < ev->n; k++)
+        set_misses[ev->sets[k] * HEAT_BUCKETS + (long) k * HEAT_BUCKETS / ev->n] += ev->counts[k];
+
+    sprintf(base, "%s.f%d.sets", heatmap_prefix, func);
+    write_heatmap(base, num_sets, HEAT_BUCKETS, set_misses);
+    if (ev->addrs[2] && ev->addrs[3]) {
+        sprintf(base, "%s.f%d.A", heatmap_prefix, func);
+        write_heatmap(base, N, M, ev->a_misses);
+        sprintf(base, "%s.f%d.B", heatmap_prefix, func);
+        write_heatmap(base, M, N, ev->b_misses);
+        printf("Step 3: Wrote heatmaps %s.f%d.{sets,A,B}.{csv,ppm}\n", heatmap_prefix, func);
+    } else {
+        printf("Step 3: Wrote heatmap %s.f%d.sets.{csv,ppm} (.marker has no A/B addresses)\n",
+               heatmap_prefix, func);
+    }
+    free(set_misses);
+}
+
+/*
+ * matrix_hook - Memory hook for the instrumented transpose functions.
+ *     Accesses to A, B and the in-place scratch are moved to where
+ *     tracegen has them; all others are locals on the stack, which the
+ *     valgrind path filters out too.
+ */
+void matrix_hook(void* ctx, addr_t addr, int size, char op)
+{
+    struct evaluation* ev = ctx;
+
+    if (addr - (addr_t) A < sizeof(A))
+        eval_access(ev, op, ev->addrs[2] + (addr - (addr_t) A), size);
+    else if (addr - (addr_t) B < sizeof(B))
+        eval_access(ev, op, ev->addrs[3] + (addr - (addr_t) B), size);
+    else if (addr - (addr_t) &in_place_scratch < sizeof(in_place_scratch))
+        eval_access(ev, op, ev->addrs[4] + (addr - (addr_t) &in_place_scratch), size);
+}
+
+/*
+ * kernel_hook - Memory hook for the instrumented kernels: only accesses to
+ *     kernel data count, placed at their offset in the arena from
+ *     KERNEL_BASE so that the sets they map to do not vary between runs
+ */
+#define KERNEL_BASE 0x10000000ULL
+
+void kernel_hook(void* ctx, addr_t addr, int size, char op)
+{
+    size_t arena_size;
+    char* arena = kernelArena(&arena_size);
+
+    if (addr - (addr_t) arena < arena_size)
+        eval_access(ctx, op, KERNEL_BASE + (addr - (addr_t) arena), size);
+}
+
+/*
+ * run_in_process - Run transpose function f (compiled with load/store
+ *     hooks, see memhook.h) on A and B, evaluating the same accesses a
+ *     valgrind trace of tracegen would have, marker stores included.
+ *     Returns 1 if it transposed A correctly, 0 otherwise.
+ */
+int run_in_process(struct evaluation* ev, trans_func_t* f)
+{
+    static int C[MAXN][MAXN];
+
+    initMatrix(M, N, A, B);
+    if (f->in_place_ptr)
+        memcpy(B, A, (size_t) M * N * sizeof(int)); /* it transposes B */
+    eval_access(ev, 'S', ev->addrs[0], 1);
+    memHookSet(matrix_hook, ev);
+    runTransFunction(f, M, N, A, B);
+    memHookSet(NULL, NULL);
+    eval_access(ev, 'S', ev->addrs[1], 1);
+
+    /* B and C both hold the M x N result contiguously */
+    correctTrans(M, N, A, C);
+    return memcmp(B, C, (size_t) M * N * sizeof(int)) == 0;
+}
+
+/*
+ * read_markers - Read the marker, A, B and scratch addresses tracegen left
+ *     in .marker. In-process runs use them so that their counts agree with
+ *     a valgrind run, and fall back to our own addresses without them.
+ */
+void read_markers(unsigned long long addrs[5])
+{
+    FILE* marker_fp = fopen(".marker", "r");
+    int n = 0;
+
+    assert(marker_fp || in_process);
+    if (marker_fp)
+        n = fscanf(marker_fp, "%llx %llx %llx %llx %llx",
+                   &addrs[0], &addrs[1], &addrs[2], &addrs[3], &addrs[4]);
+    if (n < 4)
+        addrs[2] = addrs[3] = 0; /* written by an older tracegen */
+    if (n < 5)
+        addrs[4] = 0;
+    if (in_process) {
+        if (n < 4) {
+            addrs[0] = (unsigned long long) &markers[0];
+            addrs[1] = (unsigned long long) &markers[1];
+            addrs[2] = (unsigned long long) A;
+            addrs[3] = (unsigned long long) B;
+        }
+        if (n < 5)
+            addrs[4] = (unsigned long long) &in_place_scratch;
+    }
+    if (marker_fp)
+        fclose(marker_fp);
+}
+
+/* The tile transpose_tiled uses when -S runs it as tile_candidate */
+static int tune_rows, tune_cols;
+
+void tile_candidate(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_tiled(M, N, A, B, tune_rows, tune_cols);
+}
+
+static trans_func_t tile_candidate_func = {tile_candidate, NULL, "tile candidate"};
+
+/*
+ * eval_in_process - Misses of f on the current M x N shape, or -1 if it
+ *     does not transpose correctly
+ */
+long eval_in_process(trans_func_t* f, unsigned int s, unsigned int E, unsigned int b,
+                     unsigned long long addrs[5])
+{
+    struct evaluation ev;
+    long misses;
+
+    eval_begin(&ev, -1, s, E, b, addrs);
+    misses = run_in_process(&ev, f) ? (long) ev.sim.misses : -1;
+    eval_end(&ev);
+    return misses;
+}
+
+/*
+ * eval_sweep - Run every registered function in-process over
+ *     sweep_shapes, then tune transpose_tiled's tile for each shape and
+ *     print the winners as entries for transpose_tuned's table in trans.c
+ */
+void eval_sweep(unsigned int s, unsigned int E, unsigned int b)
+{
+    unsigned long long addrs[5] = {0, 0, 0, 0, 0};
+    int shape, i, r, c, num_shapes = sizeof(sweep_shapes) / sizeof(sweep_shapes[0]);
+    int num_sides = sizeof(tile_sides) / sizeof(tile_sides[0]);
+    int best_rows[num_shapes], best_cols[num_shapes];
+    long misses, best[num_shapes];
+
+    registerFunctions();
+    registerTunedFunctions();
+    read_markers(addrs);
+
+    printf("Misses (s=%u, E=%u, b=%u); - if incorrect, tiled = tuned transpose_tiled\n", s, E, b);
+    for (i = 0; i < func_counter; i++)
+        printf("  f%d: %s\n", i, func_list[i].description);
+    printf("%10s", "M x N");
+    for (i = 0; i < func_counter; i++)
+        printf(" %7s%d", "f", i);
+    printf(" %8s %7s\n", "tiled", "tile");
+
+    for (shape = 0; shape < num_shapes; shape++) {
+        M = sweep_shapes[shape][0];
+        N = sweep_shapes[shape][1];
+        printf("%4d x %-3d", M, N);
+        for (i = 0; i < func_counter; i++) {
+            misses = eval_in_process(&func_list[i], s, E, b, addrs);
+            if (misses < 0)
+                printf(" %8s", "-");
+            else
+                printf(" %8ld", misses);
+        }
+
+        best[shape] = LONG_MAX;
+        for (r = 0; r < num_sides; r++) {
+            for (c = 0; c < num_sides; c++) {
+                tune_rows = tile_sides[r];
+                tune_cols = tile_sides[c];
+                misses = eval_in_process(&tile_candidate_func, s, E, b, addrs);
+                if (misses >= 0 && misses < best[shape]) {
+                    best[shape] = misses;
+                    best_rows[shape] = tune_rows;
+                    best_cols[shape] = tune_cols;
+                }
+            }
+        }
+        printf(" %8ld %3dx%-3d\n", best[shape], best_rows[shape], best_cols[shape]);
+    }
+
+    printf("\nTuned tiles for trans.c (M, N, rows, cols):\n");
+    for (shape = 0; shape < num_shapes; shape++)
+        printf("    {%d, %d, %d, %d},\n", sweep_shapes[shape][0], sweep_shapes[shape][1],
+               best_rows[shape], best_cols[shape]);
+}
+
+/* The schedule -G runs as schedule_candidate */
+static schedule_t tune_schedule;
+
+void schedule_candidate(int M, int N, int A[N][M], int B[M][N])
+{
+    runSchedule(&tune_schedule, M, N, A, B);
+}
+
+static trans_func_t schedule_candidate_func = {schedule_candidate, NULL, "schedule candidate"};
+
+/*
+ * eval_tune - Search the schedule family of schedule.h on every sweep
+ *     shape: plain tiles of tile_sides in both tile and element orders,
+ *     with and without diagonal deferral, tiles staged up to 8 wide, and
+ *     the halves trick. Writes the winners to path as C: one function per
+ *     shape, transpose_autotuned to choose by shape, and
+ *     registerTunedFunctions to register it.
+ */
+void eval_tune(char *path, unsigned int s, unsigned int E, unsigned int b)
+{
+    unsigned long long addrs[5] = {0, 0, 0, 0, 0};
+    int shape, i, r, c, order, num_cands = 0;
+    int num_shapes = sizeof(sweep_shapes) / sizeof(sweep_shapes[0]);
+    int num_sides = sizeof(tile_sides) / sizeof(tile_sides[0]);
+    schedule_t cands[num_sides * num_sides * 8 + num_sides * 4 * 2 + 2];
+    schedule_t best[num_shapes];
+    schedule_t fallback = {SCHED_PLAIN, 8, 8, false, false, true};
+    long misses, best_misses[num_shapes];
+    char desc[100], name[32];
+    FILE *fp;
+
+    for (r = 0; r < num_sides; r++) {
+        for (c = 0; c < num_sides; c++) {
+            for (order = 0; order < 8; order++)
+                cands[num_cands++] = (schedule_t) {SCHED_PLAIN, tile_sides[r], tile_sides[c],
+                                                   order & 1, (order >> 1) & 1, (order >> 2) & 1};
+            for (order = 0; order < 2 && tile_sides[c] <= 8; order++)
+                cands[num_cands++] = (schedule_t) {SCHED_STAGED, tile_sides[r], tile_sides[c],
+                                                   order, false, false};
+        }
+    }
+    cands[num_cands++] = (schedule_t) {SCHED_HALVES, 8, 8, false, false, false};
+    cands[num_cands++] = (schedule_t) {SCHED_HALVES, 8, 8, true, false, false};
+
+    read_markers(addrs);
+    printf("Best of %d schedules per shape (s=%u, E=%u, b=%u)\n", num_cands, s, E, b);
+    for (shape = 0; shape < num_shapes; shape++) {
+        M = sweep_shapes[shape][0];
+        N = sweep_shapes[shape][1];
+        best_misses[shape] = LONG_MAX;
+        for (i = 0; i < num_cands; i++) {
+            tune_schedule = cands[i];
+            misses = eval_in_process(&schedule_candidate_func, s, E, b, addrs);
+            if (misses >= 0 && misses < best_misses[shape]) {
+                best_misses[shape] = misses;
+                best[shape] = cands[i];
+            }
+        }
+        describeSchedule(&best[shape], desc, sizeof(desc));
+        printf("%4d x %-3d %8ld  %s\n", M, N, best_misses[shape], desc);
+        fflush(stdout);
+    }
+
+    if ((fp = fopen(path, "w")) == NULL) {
+        printf("Error: Unable to write %s\n", path);
+        exit(1);
+    }
+    fprintf(fp, "/*\n * %s - Transposes generated by test-trans -G\n *\n", path);
+    fprintf(fp, " * Do not edit; rerun test-trans -G instead. Each function is the schedule\n");
+    fprintf(fp, " * (schedule.h) with the fewest misses on its shape for s=%u, E=%u, b=%u,\n", s, E, b);
+    fprintf(fp, " * and transpose_autotuned picks one by shape.\n */\n#include \"cachelab.h\"\n");
+    for (shape = 0; shape < num_shapes; shape++) {
+        describeSchedule(&best[shape], desc, sizeof(desc));
+        fprintf(fp, "\n/* %d x %d: %s; %ld misses */\n", sweep_shapes[shape][0],
+                sweep_shapes[shape][1], desc, best_misses[shape]);
+        sprintf(name, "tuned_%dx%d", sweep_shapes[shape][0], sweep_shapes[shape][1]);
+        emitSchedule(fp, name, &best[shape]);
+    }
+    describeSchedule(&fallback, desc, sizeof(desc));
+    fprintf(fp, "\n/* Any other shape: %s */\n", desc);
+    emitSchedule(fp, "tuned_default", &fallback);
+
+    fprintf(fp, "\nchar transpose_autotuned_desc[] = \"Auto-tuned schedule per shape\";\n");
+    fprintf(fp, "void transpose_autotuned(int M, int N, int A[N][M], int B[M][N])\n{\n");
+    for (shape = 0; shape < num_shapes; shape++)
+        fprintf(fp, "    %sif (M == %d && N == %d)\n        tuned_%dx%d(M, N, A, B);\n",
+                shape ? "else " : "", sweep_shapes[shape][0], sweep_shapes[shape][1],
+                sweep_shapes[shape][0], sweep_shapes[shape][1]);
+    fprintf(fp, "    else\n        tuned_default(M, N, A, B);\n}\n");
+    fprintf(fp, "\nvoid registerTunedFunctions()\n{\n");
+    fprintf(fp, "    registerTransFunction(transpose_autotuned, transpose_autotuned_desc);\n}\n");
+    fclose(fp);
+    printf("Wrote %s; rebuild (make) to evaluate transpose_autotuned\n", path);
+}
+
+/*
+ * estimate_cycles - The cost model's estimate (cost.h defaults, L1 and
+ *     memory) of hits and misses of int accesses with 2^b-byte blocks
+ */
+double estimate_cycles(unsigned long hits, unsigned long misses, unsigned int b)
+{
+    cost_model_t model;
+    cost_usage_t usage[2];
+    cost_estimate_t est;
+
+    costInit(&model);
+    usage[0].lookups = hits + misses;
+    usage[0].bytes = (hits + misses) * sizeof(int);
+    usage[1].lookups = misses;
+    usage[1].bytes = (unsigned long long) misses << b;
+    costEstimate(&model, usage, 1, hits + misses, 0.0, &est);
+    return est.cycles;
+}
+
+/*
+ * eval_kernels - Evaluate every kernel of kernels.c in-process, with the
+ *     -P overrides applied to the parameters they name, and write each
+ *     one's accesses to trace.k<i>
+ */
+void eval_kernels(unsigned int s, unsigned int E, unsigned int b)
+{
+    unsigned long long addrs[5] = {0, 0, 0, 0, 0};
+    struct evaluation ev;
+    kernel_func_t *k;
+    void *bufs[MAX_KERNEL_BUFS];
+    char filename[64], params[128], name[32], extra;
+    int i, p, o, value, used[MAX_KERNEL_PARAMS * 4] = {0};
+
+    /* Every parameter is a size, stride or block size, where 0 would copy
+       nothing or never finish */
+    for (o = 0; o < num_overrides; o++) {
+        if (sscanf(strchr(param_overrides[o], '=') + 1, "%d%c", &value, &extra) != 1 ||
+            value <= 0) {
+            printf("Error: -P %s needs a positive integer value\n", param_overrides[o]);
+            exit(1);
+        }
+    }
+
+    /* Apply the overrides, and check that every kernel's data fits the
+       arena (leaving room to align each buffer) before any of them runs */
+    registerKernels();
+    for (i = 0; i < kernel_counter; i++) {
+        k = &kernel_list[i];
+        for (p = 0; p < k->num_params; p++) {
+            for (o = 0; o < num_overrides; o++) {
+                if (sscanf(param_overrides[o], "%31[^=]=%d", name, &value) == 2 &&
+                    strcmp(name, k->param_names[p]) == 0) {
+                    k->params[p] = value;
+                    used[o] = 1;
+                }
+            }
+        }
+        if ((*k->data_size)(k->params) > KERNEL_ARENA_SIZE - MAX_KERNEL_BUFS * 64) {
+            printf("Error: kernel %d (%s) needs more than %d MB of data with these parameters\n",
+                   i, k->description, KERNEL_ARENA_SIZE >> 20);
+            exit(1);
+        }
+    }
+
+    for (i = 0; i < kernel_counter; i++) {
+        k = &kernel_list[i];
+        params[0] = '\0';
+        for (p = 0; p < k->num_params; p++)
+            sprintf(params + strlen(params), "%s%s=%d", p ? ", " : "",
+                    k->param_names[p], k->params[p]);
+
+        kernelReset();
+        memset(bufs, 0, sizeof(bufs));
+        (*k->setup)(k->params, bufs);
+
+        eval_begin(&ev, -1, s, E, b, addrs);
+        sprintf(filename, "trace.k%d", i);
+        ev.trace_fp = fopen(filename, "w");
+        assert(ev.trace_fp);
+        memHookSet(kernel_hook, &ev);
+        (*k->run)(k->params, bufs);
+        memHookSet(NULL, NULL);
+        printf("kernel %d (%s; %s): hits:%lu, misses:%lu, evictions:%lu, cycles:%.0f\n", i,
+               k->description, params, ev.sim.hits, ev.sim.misses, ev.sim.evictions,
+               estimate_cycles(ev.sim.hits, ev.sim.misses, b));
+        eval_end(&ev);
+    }
+    for (o = 0; o < num_overrides; o++)
+        if (!used[o])
+            printf("Warning: no kernel has the parameter in -P %s\n", param_overrides[o]);
+}
+
+/* seconds - Monotonic wall-clock time in seconds */
+double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * eval_bandwidth - Time the native fastTranspose kernels on square and
+ *     ragged matrices of up to max_mb megabytes each, doubling the side
+ *     from 256. Bandwidth counts A read plus B written; each kernel runs
+ *     until 0.2 s have passed, after one untimed run that is checked.
+ */
+void eval_bandwidth(int max_mb)
+{
+    size_t max_elems = ((size_t) max_mb << 20) / sizeof(int32_t);
+    size_t n, rows, cols, i, j, reps;
+    int32_t *a, *b;
+    int k, ragged;
+    double start, elapsed;
+
+    /* 2 MB aligned and backed by huge pages where the kernel allows, so
+       that the strided side of a tile costs few TLB misses */
+    if (posix_memalign((void**) &a, 1 << 21, max_elems * sizeof(int32_t)) != 0 ||
+        posix_memalign((void**) &b, 1 << 21, max_elems * sizeof(int32_t)) != 0) {
+        printf("Error: Unable to allocate two %d MB matrices\n", max_mb);
+        exit(1);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(a, max_elems * sizeof(int32_t), MADV_HUGEPAGE);
+    madvise(b, max_elems * sizeof(int32_t), MADV_HUGEPAGE);
+#endif
+    for (i = 0; i < max_elems; i++) {
+        a[i] = (int32_t) i;
+        b[i] = 0;
+    }
+
+    printf("Native transpose, GB/s of A read + B written (auto = %s)\n",
+           kernelNames[kernelResolve(KERNEL_AUTO)]);
+    printf("%15s %9s", "rows x cols", "MB");
+    for (k = KERNEL_SCALAR; k < NUM_KERNELS; k++)
+        printf(" %8s", kernelNames[k]);
+    printf("\n");
+
+    for (n = 256; n * n <= max_elems; n *= 2) {
+        for (ragged = 0; ragged < 2; ragged++) {
+            /* Ragged shapes leave partial 8 x 8 blocks on both edges */
+            rows = ragged ? n + 3 : n;
+            cols = ragged ? n - 5 : n;
+            printf("%6zu x %-6zu %9.2f", rows, cols, rows * cols * sizeof(int32_t) / 1048576.0);
+            for (k = KERNEL_SCALAR; k < NUM_KERNELS; k++) {
+                if (!kernelSupported(k)) {
+                    printf(" %8s", "-");
+                    continue;
+                }
+                fastTranspose(a, b, rows, cols, k);
+                for (i = 0; i < rows; i++)
+                    for (j = 0; j < cols; j++)
+                        if (b[j * rows + i] != a[i * cols + j]) {
+                            printf("\nError: %s kernel is wrong at A[%zu][%zu]\n", kernelNames[k], i, j);
+                            exit(1);
+                        }
+                start = seconds();
+                reps = 0;
+                do {
+                    fastTranspose(a, b, rows, cols, k);
+                    reps++;
+                    elapsed = seconds() - start;
+                } while (elapsed < 0.2);
+                printf(" %8.2f", 2.0 * rows * cols * sizeof(int32_t) * reps / elapsed / 1e9);
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+    }
+    free(a);
+    free(b);
+}
+
+/* touch_job - Arguments of first_touch: an n x n A and B */
+struct touch_job {
+    int32_t *a, *b;
+    size_t n;
+};
+
+/*
+ * first_touch - Worker t of a pool fills its band of A's rows and zeroes
+ *     its band of B's rows, so that each page is placed on the node of the
+ *     thread that first touches it; the B band is the one the worker later
+ *     writes in fastTransposeParallel
+ */
+void first_touch(void *arg, int t, int num_threads)
+{
+    struct touch_job *job = (struct touch_job *) arg;
+    size_t start, end, i;
+
+    transBand(job->n, t, num_threads, &start, &end);
+    for (i = start * job->n; i < end * job->n; i++) {
+        job->a[i] = (int32_t) i;
+        job->b[i] = 0;
+    }
+}
+
+/*
+ * eval_scaling - Time fastTransposeParallel with 1, 2, 4, ... max_threads
+ *     threads on square matrices from 1K x 1K, doubling the side while a
+ *     matrix fits in max_mb megabytes (32K x 32K needs 4096). Each run gets
+ *     freshly allocated matrices, first-touched by the pool that then
+ *     transposes them, and is checked once before being timed.
+ */
+void eval_scaling(int max_mb, int max_threads)
+{
+    size_t max_elems = ((size_t) max_mb << 20) / sizeof(int32_t);
+    size_t n, i, j, step, reps;
+    int threads, counts[MAX_POOL_THREADS], num_counts = 0, k;
+    double start, elapsed, gbs, base = 0;
+    trans_pool_t *pool;
+    struct touch_job job;
+
+    for (threads = 1; threads < max_threads; threads *= 2)
+        counts[num_counts++] = threads;
+    counts[num_counts++] = max_threads;
+
+    printf("Parallel transpose (%s), GB/s of A read + B written and speedup over 1 thread\n",
+           kernelNames[kernelResolve(KERNEL_AUTO)]);
+    printf("%15s %9s", "rows x cols", "MB");
+    for (k = 0; k < num_counts; k++)
+        printf(" %7d thr", counts[k]);
+    printf("\n");
+
+    for (n = 1024; n * n <= max_elems; n *= 2) {
+        printf("%6zu x %-6zu %9.2f", n, n, n * n * sizeof(int32_t) / 1048576.0);
+        for (k = 0; k < num_counts; k++) {
+            if ((pool = transPoolCreate(counts[k])) == NULL) {
+                printf("\nError: Unable to start %d threads\n", counts[k]);
+                exit(1);
+            }
+            job.n = n;
+            if (posix_memalign((void**) &job.a, 1 << 21, n * n * sizeof(int32_t)) != 0 ||
+                posix_memalign((void**) &job.b, 1 << 21, n * n * sizeof(int32_t)) != 0) {
+                printf("\nError: Unable to allocate two %zu x %zu matrices\n", n, n);
+                exit(1);
+            }
+#ifdef MADV_HUGEPAGE
+            madvise(job.a, n * n * sizeof(int32_t), MADV_HUGEPAGE);
+            madvise(job.b, n * n * sizeof(int32_t), MADV_HUGEPAGE);
+#endif
+            transPoolRun(pool, first_touch, &job);
+
+            /* Checking every element of a large B is a strided walk that
+               costs more than the runs, so check every step-th row */
+            fastTransposeParallel(pool, job.a, job.b, n, n, KERNEL_AUTO);
+            step = (n <= 4096) ? 1 : n / 4096 + 1;
+            for (i = 0; i < n; i += step)
+                for (j = 0; j < n; j++)
+                    if (job.b[j * n + i] != job.a[i * n + j]) {
+                        printf("\nError: %d-thread transpose is wrong at A[%zu][%zu]\n",
+                               counts[k], i, j);
+                        exit(1);
+                    }
+
+            start = seconds();
+            reps = 0;
+            do {
+                fastTransposeParallel(pool, job.a, job.b, n, n, KERNEL_AUTO);
+                reps++;
+                elapsed = seconds() - start;
+            } while (elapsed < 0.2);
+            gbs = 2.0 * n * n * sizeof(int32_t) * reps / elapsed / 1e9;
+            if (k == 0)
+                base = gbs;
+            printf(" %5.2f %4.2fx", gbs, gbs / base);
+            fflush(stdout);
+
+            transPoolFree(pool);
+            free(job.a);
+            free(job.b);
+        }
+        printf("\n");
+    }
+}
+
+/*
+ * print_ranking - List the correct functions by estimated cycles, which
+ *     also weigh the hits that a miss count ignores
+ */
+void print_ranking(unsigned int b)
+{
+    int order[MAX_TRANS_FUNCS], n = 0, i, j, t;
+    double cycles[MAX_TRANS_FUNCS];
+    cost_model_t model;
+
+    for (i = 0; i < func_counter; i++) {
+        if (!func_list[i].correct || func_list[i].num_hits + func_list[i].num_misses == 0)
+            continue;
+        cycles[i] = estimate_cycles(func_list[i].num_hits, func_list[i].num_misses, b);
+        for (j = n++; j > 0 && cycles[order[j - 1]] > cycles[i]; j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+    if (n < 2)
+        return;
+    costInit(&model);
+    printf("\nRanked by estimated cycles (cost.h: L1 hit %g, memory %g cycles):\n",
+           model.caches[0].latency, model.mem.latency);
+    for (j = 0; j < n; j++) {
+        t = order[j];
+        printf("%12.0f cycles %8u misses  func %d (%s)\n", cycles[t],
+               func_list[t].num_misses, t, func_list[t].description);
+    }
+}
+
 /* 
  * eval_perf - Evaluate the performance of the registered transpose functions
  */
 void eval_perf(unsigned int s, unsigned int E, unsigned int b)
 {
-    int i,flag;
-    unsigned int len, hits, misses, evictions;
-    unsigned long long int marker_start, marker_end, addr;
-    char buf[1000], cmd[255];
-    char filename[128];
+    int i,flag,n;
+    unsigned long long int addrs[5] = {0, 0, 0, 0, 0}; /* markers, A, B and scratch */
+    struct evaluation ev;
+    char cmd[255];
 
     registerFunctions(); 
+    registerTunedFunctions();
 
-    /* Open the complete trace file */
-    FILE* full_trace_fp;  
-    FILE* part_trace_fp; 
+    /* A captured trace comes with the markers of the run that produced
+       it; read them before the validation runs below overwrite .marker */
+    if (capture_file || in_process)
+        read_markers(addrs);
 
     /* Evaluate the performance of each registered transpose function */
 
@@ -66,22 +907,27 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
 
 
         printf("\nFunction %d (%d total)\nStep 1: Validating and generating memory traces\n",i,func_counter);
-        /* Use valgrind to generate the trace */
-
-        sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen -M %d -N %d -F %d  > trace.tmp", M, N,i);
-        flag=WEXITSTATUS(system(cmd));
+        if (in_process) {
+            /* Run it here, on the instrumented build of trans.c */
+            eval_begin(&ev, i, s, E, b, addrs);
+            flag = run_in_process(&ev, &func_list[i]) ? 0 : i + 1;
+            if (0!=flag)
+                eval_end(&ev);
+        } else {
+            if (capture_file) {
+                /* The trace already exists, so only check correctness natively */
+                sprintf(cmd, "./tracegen -M %d -N %d -F %d > /dev/null", M, N, i);
+            } else {
+                /* Use valgrind to generate the trace */
+                sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen -M %d -N %d -F %d  > trace.tmp", M, N,i);
+            }
+            flag=WEXITSTATUS(system(cmd));
+        }
         if (0!=flag) {
             printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);      
             continue;
         }
 
-        /* Get the start and end marker addresses */
-        FILE* marker_fp = fopen(".marker", "r");
-        assert(marker_fp);
-        fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
-        fclose(marker_fp);
-
-
         func_list[i].correct=1;
 
         /* Save the correctness of the transpose submission */
@@ -89,87 +935,85 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
             results.correct = 1;
         }
 
-        full_trace_fp = fopen("trace.tmp", "r");
-        assert(full_trace_fp);
-
-
-        /* Filtered trace for each transpose function goes in a separate file */
-        sprintf(filename, "trace.f%d", i);
-        part_trace_fp = fopen(filename, "w");
-        assert(part_trace_fp);
-    
-        /* Locate trace corresponding to the trans function */
-        flag = 0;
-        while (fgets(buf, 1000, full_trace_fp) != NULL) {
-
-            /* We are only interested in memory access instructions */
-            if (buf[0]==' ' && buf[2]==' ' &&
-                (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
-                sscanf(buf+3, "%llx,%u", &addr, &len);
-        
-                /* If start marker found, set flag */
-                if (addr == marker_start)
-                    flag = 1;
-
-                /* Valgrind creates many spurious accesses to the
-                   stack that have nothing to do with the students
-                   code. At the moment, we are ignoring all stack
-                   accesses by using the simple filter of recording
-                   accesses to only the low 32-bit portion of the
-                   address space. At some point it would be nice to
-                   try to do more informed filtering so that would
-                   eliminate the valgrind stack references while
-                   include the student stack references. */
-                if (flag && addr < 0xffffffff) {
-                    fputs(buf, part_trace_fp);
-                }
+        /* Simulate the function's accesses, which also go to trace.f<i> */
+        if (capture_file && !in_process) {
+            /* Function i is the i'th marked region of the captured trace */
+            eval_begin(&ev, i, s, E, b, addrs);
+            if (eval_region(capture_file, i, &ev, addrs[0], addrs[1]) < 0) {
+                printf("Could not find function %d in %s.\n", i, capture_file);
+                eval_end(&ev);
+                continue;
+            }
+        } else if (!in_process) {
+            /* Get the start and end marker addresses */
+            FILE* marker_fp = fopen(".marker", "r");
+            assert(marker_fp);
+            n = fscanf(marker_fp, "%llx %llx %llx %llx %llx",
+                       &addrs[0], &addrs[1], &addrs[2], &addrs[3], &addrs[4]);
+            if (n < 4)
+                addrs[2] = addrs[3] = 0;
+            fclose(marker_fp);
 
-                /* if end marker found, close trace file */
-                if (addr == marker_end) {
-                    flag = 0;
-                    fclose(part_trace_fp);
-                    break;
-                }
+            /* Locate trace corresponding to the trans function */
+            eval_begin(&ev, i, s, E, b, addrs);
+            if (eval_region("trace.tmp", 0, &ev, addrs[0], addrs[1]) < 0) {
+                printf("Could not find the trace of function %d in trace.tmp.\n", i);
+                eval_end(&ev);
+                continue;
             }
         }
-        fclose(full_trace_fp);
 
-        /* Run the reference simulator */
         printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
-        char cmd[255];
-        sprintf(cmd, "./csim-ref -s %u -E %u -b %u -t trace.f%d > /dev/null", 
-                s, E, b, i);
-        system(cmd);
-    
-        /* Collect results from the reference simulator */
-        FILE* in_fp = fopen(".csim_results","r");
-        assert(in_fp);
-        fscanf(in_fp, "%u %u %u", &hits, &misses, &evictions);
-        fclose(in_fp);
-        func_list[i].num_hits = hits;
-        func_list[i].num_misses = misses;
-        func_list[i].num_evictions = evictions;
-        printf("func %u (%s): hits:%u, misses:%u, evictions:%u\n",
-               i, func_list[i].description, hits, misses, evictions);
+        func_list[i].num_hits = ev.sim.hits;
+        func_list[i].num_misses = ev.sim.misses;
+        func_list[i].num_evictions = ev.sim.evictions;
+        printf("func %u (%s): hits:%lu, misses:%lu, evictions:%lu\n",
+               i, func_list[i].description, ev.sim.hits, ev.sim.misses, ev.sim.evictions);
     
         /* If it is transpose_submit(), record number of misses */
         if (results.funcid == i) {
-            results.misses = misses;
+            results.misses = ev.sim.misses;
         }
+
+        if (heatmap_prefix)
+            write_heatmaps(&ev, i);
+        eval_end(&ev);
     }
-  
+    print_ranking(b);
 }
 
 /*
  * usage - Print usage info
  */
 void usage(char *argv[]){
-    printf("Usage: %s [-h] -M <rows> -N <cols>\n", argv[0]);
+    printf("Usage: %s [-hi] -M <rows> -N <cols> [-t <trace>] [-H <prefix>]\n", argv[0]);
+    printf("       %s -S\n", argv[0]);
+    printf("       %s -G <file>\n", argv[0]);
+    printf("       %s -K [-P <name>=<value>]...\n", argv[0]);
+    printf("       %s -B <MB> [-T <threads>]\n", argv[0]);
     printf("Options:\n");
     printf("  -h          Print this help message.\n");
     printf("  -M <rows>   Number of matrix rows (max %d)\n", MAXN);
     printf("  -N <cols>   Number of  matrix columns (max %d)\n", MAXN);
+    printf("  -t <trace>  Use a captured trace (text or binary) of all functions\n");
+    printf("              instead of running valgrind for each one\n");
+    printf("  -i          Trace the functions in-process, without valgrind\n");
+    printf("  -S          Sweep: misses of every function in-process over a set of\n");
+    printf("              shapes, and the best transpose_tiled tile for each\n");
+    printf("  -G <file>   Search transpose schedules (schedule.h) on the -S shapes\n");
+    printf("              and write the best per shape to <file> as C (trans-tuned.c)\n");
+    printf("  -K          Evaluate the memory kernels of kernels.c (matmul, stencil,\n");
+    printf("              gather/scatter, memcpy) in-process, traces to trace.k<i>\n");
+    printf("  -P <name>=<value> With -K, set that parameter of every kernel that has it\n");
+    printf("  -B <MB>     Benchmark the native scalar/SSE2/AVX2 kernels (fasttrans.c)\n");
+    printf("              in GB/s on matrices of up to <MB> megabytes each\n");
+    printf("  -T <threads> With -B, time the parallel transpose on 1, 2, 4, ... <threads>\n");
+    printf("              threads instead, from 1K x 1K up to <MB> megabytes\n");
+    printf("  -H <prefix> Write miss heatmaps (CSV and PPM) per function: cache set\n");
+    printf("              by time to <prefix>.f<i>.sets, elements to <prefix>.f<i>.A/.B\n");
     printf("Example: %s -M 8 -N 8\n", argv[0]);       
+    printf("Capture: valgrind --tool=lackey --trace-mem=yes --log-fd=1 ./tracegen -M 8 -N 8 | ./trace2bin -o 8x8.ctr\n");
+    printf("         %s -M 8 -N 8 -t 8x8.ctr\n", argv[0]);
 }
 
 /*
@@ -199,7 +1043,7 @@ int main(int argc, char* argv[])
 {
     char c;
 
-    while ((c = getopt(argc,argv,"M:N:h")) != -1) {
+    while ((c = getopt(argc,argv,"M:N:t:H:iSB:T:G:KP:h")) != -1) {
         switch(c) {
         case 'M':
             M = atoi(optarg);
@@ -207,6 +1051,48 @@ int main(int argc, char* argv[])
         case 'N':
             N = atoi(optarg);
             break;
+        case 't':
+            capture_file = optarg;
+            break;
+        case 'H':
+            heatmap_prefix = optarg;
+            break;
+        case 'i':
+            in_process = 1;
+            break;
+        case 'S':
+            sweep = in_process = 1;
+            break;
+        case 'B':
+            bench_mb = atoi(optarg);
+            if (bench_mb < 1) {
+                printf("Error: -B needs a size of at least 1 MB\n");
+                exit(1);
+            }
+            break;
+        case 'K':
+            kernels = 1;
+            break;
+        case 'P':
+            if (num_overrides == sizeof(param_overrides) / sizeof(param_overrides[0]) ||
+                strchr(optarg, '=') == NULL) {
+                printf("Error: -P takes name=value, at most %d times\n",
+                       (int) (sizeof(param_overrides) / sizeof(param_overrides[0])));
+                exit(1);
+            }
+            param_overrides[num_overrides++] = optarg;
+            break;
+        case 'G':
+            tune_file = optarg;
+            in_process = 1;
+            break;
+        case 'T':
+            bench_threads = atoi(optarg);
+            if (bench_threads < 1 || bench_threads > MAX_POOL_THREADS) {
+                printf("Error: -T needs 1 to %d threads\n", MAX_POOL_THREADS);
+                exit(1);
+            }
+            break;
         case 'h':
             usage(argv);
             exit(0);
@@ -216,7 +1102,13 @@ int main(int argc, char* argv[])
         }
     }
   
-    if (M == 0 || N == 0) {
+    if (bench_threads && !bench_mb) {
+        printf("Error: -T needs -B\n");
+        usage(argv);
+        exit(1);
+    }
+
+    if (!sweep && !bench_mb && !tune_file && !kernels && (M == 0 || N == 0)) {
         printf("Error: Missing required argument\n");
         usage(argv);
         exit(1);
@@ -242,6 +1134,28 @@ int main(int argc, char* argv[])
     /* Time out and give up after a while */
     alarm(120);
 
+    if (sweep) {
+        eval_sweep(5, 1, 5);
+        return 0;
+    }
+    if (kernels) {
+        eval_kernels(5, 1, 5);
+        return 0;
+    }
+    if (tune_file) {
+        alarm(0); /* hundreds of candidates per shape */
+        eval_tune(tune_file, 5, 1, 5);
+        return 0;
+    }
+    if (bench_mb) {
+        alarm(0); /* large matrices take a while */
+        if (bench_threads)
+            eval_scaling(bench_mb, bench_threads);
+        else
+            eval_bandwidth(bench_mb);
+        return 0;
+    }
+
     /* Check the performance of the student's transpose function */
     eval_perf(5, 1, 5);
   
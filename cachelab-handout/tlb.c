@@ -0,0 +1,149 @@
+/*
+ * tlb.c - dTLB, STLB and page-walk cache, each an LRU cache_t
+ *
+ * The TLBs are indexed by virtual page number like a data cache by block
+ * number. The page-walk cache has one fully associative cache_t (a single
+ * set) per upper page table level, tagged with the address bits that
+ * select the entry at that level: va >> 39 for a PML4 entry, va >> 30 for
+ * a PDPT entry, va >> 21 for a PD entry. On a walk every level is looked
+ * up and filled, and the walk reads the page table levels below the
+ * deepest one that hit.
+ */
+#include <stdlib.h>
+#include "cachesim.h"
+#include "tlb.h"
+
+#define NUM_WALK_LEVELS 3   // page-walk cached levels: PML4, PDPT, PD
+
+char* pageSizeNames[NUM_PAGE_SIZES] = {"4k", "2m"};
+
+static const int pageShifts[NUM_PAGE_SIZES] = {12, 21};
+static const int walkShifts[NUM_WALK_LEVELS] = {39, 30, 21};
+static const int walkEntries[NUM_WALK_LEVELS] = {PWC_PML4_ENTRIES, PWC_PDPT_ENTRIES, PWC_PD_ENTRIES};
+static const char* walkNames[NUM_WALK_LEVELS] = {"pml4", "pdpt", "pd"};
+
+struct tlb {
+    page_size_t pageSize;
+    int pageShift;
+    int depth;                  // page table levels down to the leaf: 4 for 4 KB, 3 for 2 MB
+    cache_t dtlb;
+    cache_t stlb;
+    int dtlbSetBits, stlbSetBits;
+    cache_t pwc[NUM_WALK_LEVELS];
+
+    unsigned long accesses;
+    unsigned long dtlbHits;
+    unsigned long stlbHits;
+    unsigned long walks;
+    unsigned long walkRefs;     // page table entries read by walks
+    unsigned long pwcHits[NUM_WALK_LEVELS];  // walks whose deepest walk cache hit was this level
+};
+
+
+static int log2Sets(int entries, int assoc) {
+    int bits = 0;
+    while ((assoc << (bits + 1)) <= entries) {
+        bits += 1;
+    }
+    return bits;
+}
+
+
+tlb_t* tlbCreate(page_size_t pageSize) {
+    tlb_t* tlb = calloc(1, sizeof(tlb_t));
+    if (tlb == NULL) {
+        return NULL;
+    }
+    tlb->pageSize = pageSize;
+    tlb->pageShift = pageShifts[pageSize];
+    tlb->depth = (pageSize == PAGE_4K) ? 4 : 3;
+    tlb->dtlbSetBits = log2Sets(pageSize == PAGE_4K ? DTLB_4K_ENTRIES : DTLB_2M_ENTRIES, DTLB_ASSOC);
+    tlb->stlbSetBits = log2Sets(STLB_ENTRIES, STLB_ASSOC);
+
+    bool ok = initCache(&tlb->dtlb, (addr_t) 1 << tlb->dtlbSetBits, DTLB_ASSOC, POLICY_LRU) == 0 &&
+              initCache(&tlb->stlb, (addr_t) 1 << tlb->stlbSetBits, STLB_ASSOC, POLICY_LRU) == 0;
+    for (int i = 0; i < NUM_WALK_LEVELS && ok; i += 1) {
+        ok = initCache(&tlb->pwc[i], 1, walkEntries[i], POLICY_LRU) == 0;
+    }
+    if (!ok) {
+        tlbFree(tlb);
+        return NULL;
+    }
+    return tlb;
+}
+
+
+/* Walks the page table for addr and returns the number of entries read */
+static int walk(tlb_t* tlb, addr_t addr) {
+    int deepest = -1;
+
+    // The leaf level is never walk cached: a hit there is what the TLBs are for
+    for (int i = 0; i < tlb->depth - 1; i += 1) {
+        if (load(&tlb->pwc[i], 0, addr >> walkShifts[i]) == 0) {
+            deepest = i;
+        }
+    }
+    if (deepest >= 0) {
+        tlb->pwcHits[deepest] += 1;
+    }
+    return tlb->depth - (deepest + 1);
+}
+
+
+void tlbAccess(tlb_t* tlb, addr_t addr) {
+    addr_t page = addr >> tlb->pageShift;
+
+    tlb->accesses += 1;
+    if (load(&tlb->dtlb, page & (tlb->dtlb.numSets - 1), page >> tlb->dtlbSetBits) == 0) {
+        tlb->dtlbHits += 1;
+    } else if (load(&tlb->stlb, page & (tlb->stlb.numSets - 1), page >> tlb->stlbSetBits) == 0) {
+        tlb->stlbHits += 1;
+    } else {
+        tlb->walks += 1;
+        tlb->walkRefs += walk(tlb, addr);
+    }
+}
+
+
+static double percent(unsigned long part, unsigned long whole) {
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+
+double tlbCycles(tlb_t* tlb) {
+    // Every STLB lookup pays its latency, hit or miss
+    return (double) (tlb->accesses - tlb->dtlbHits) * STLB_HIT_CYCLES + (double) tlb->walkRefs * WALK_REF_CYCLES;
+}
+
+
+void tlbPrint(tlb_t* tlb, FILE* fp) {
+    unsigned long stlbLookups = tlb->accesses - tlb->dtlbHits;
+    double cycles = tlbCycles(tlb);
+
+    fprintf(fp, "dTLB: %s pages, %d entries %d-way hits:%lu misses:%lu hitrate:%.2f%%\n",
+            pageSizeNames[tlb->pageSize], DTLB_ASSOC << tlb->dtlbSetBits, DTLB_ASSOC,
+            tlb->dtlbHits, stlbLookups, percent(tlb->dtlbHits, tlb->accesses));
+    fprintf(fp, "STLB: %d entries %d-way hits:%lu misses:%lu hitrate:%.2f%%\n",
+            STLB_ASSOC << tlb->stlbSetBits, STLB_ASSOC, tlb->stlbHits, tlb->walks,
+            percent(tlb->stlbHits, stlbLookups));
+    fprintf(fp, "walks:%lu refs:%lu (%.2f per walk) walk cache hits:", tlb->walks, tlb->walkRefs,
+            tlb->walks ? (double) tlb->walkRefs / tlb->walks : 0.0);
+    for (int i = 0; i < tlb->depth - 1; i += 1) {
+        fprintf(fp, " %s:%lu", walkNames[i], tlb->pwcHits[i]);
+    }
+    fprintf(fp, "\ntranslation: %.0f cycles, %.3f per access (STLB %d, walk ref %d cycles)\n",
+            cycles, tlb->accesses ? (double) cycles / tlb->accesses : 0.0, STLB_HIT_CYCLES, WALK_REF_CYCLES);
+}
+
+
+void tlbFree(tlb_t* tlb) {
+    if (tlb == NULL) {
+        return;
+    }
+    freeCache(&tlb->dtlb);
+    freeCache(&tlb->stlb);
+    for (int i = 0; i < NUM_WALK_LEVELS; i += 1) {
+        freeCache(&tlb->pwc[i]);
+    }
+    free(tlb);
+}
@@ -0,0 +1,66 @@
+/*
+ * tlb.h - Address translation in front of csim's data caches
+ *
+ * Every data access is translated before it reaches the caches: first by
+ * the L1 dTLB, then by the second-level STLB, and on a miss in both by a
+ * walk of the x86-64 four-level page table. A page-walk cache keeps the
+ * recently used entries of the upper levels (PML4, PDPT and, for 4 KB
+ * pages, PD), so a walk only reads the levels below the deepest one it
+ * hits. Trace addresses are taken as virtual and the caches as virtually
+ * indexed, so translation never changes the cache results; it adds its own
+ * hits, misses and an estimate of the cycles spent translating.
+ *
+ * All data pages are one size per run, so running a trace once with 4 KB
+ * and once with 2 MB pages shows what huge pages would save.
+ */
+
+#ifndef TLB_H
+#define TLB_H
+
+#include <stdio.h>
+#include "traceio.h"
+
+/* Geometry, after a recent x86-64 core */
+#define DTLB_4K_ENTRIES 64
+#define DTLB_2M_ENTRIES 32
+#define DTLB_ASSOC 4
+#define STLB_ENTRIES 1536     // shared by both page sizes
+#define STLB_ASSOC 12
+#define PWC_PML4_ENTRIES 2    // page-walk cache, fully associative per level
+#define PWC_PDPT_ENTRIES 4
+#define PWC_PD_ENTRIES 32
+
+/* Cost estimate, in cycles */
+#define STLB_HIT_CYCLES 9     // dTLB miss that hits in the STLB
+#define WALK_REF_CYCLES 20    // each page table entry a walk reads, mostly from L1/L2
+
+typedef enum page_size {
+    PAGE_4K,
+    PAGE_2M,
+    NUM_PAGE_SIZES
+} page_size_t;
+
+extern char* pageSizeNames[NUM_PAGE_SIZES];
+
+typedef struct tlb tlb_t;
+
+/* tlbCreate - Empty TLBs and page-walk cache for pageSize pages. Returns NULL if out of memory. */
+tlb_t* tlbCreate(page_size_t pageSize);
+
+/* tlbAccess - Translate addr (once for a modify) */
+void tlbAccess(tlb_t* tlb, addr_t addr);
+
+/* tlbCycles - Estimated cycles spent translating so far */
+double tlbCycles(tlb_t* tlb);
+
+/*
+ * tlbPrint - Hits and hit rates of both TLBs, walks, the page table
+ *     entries they read and which walk cache level cut them short, and the
+ *     estimated translation cycles in total and per access
+ */
+void tlbPrint(tlb_t* tlb, FILE* fp);
+
+/* tlbFree - Release everything */
+void tlbFree(tlb_t* tlb);
+
+#endif /* TLB_H */
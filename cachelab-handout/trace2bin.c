@@ -0,0 +1,132 @@
+/*
+ * trace2bin.c - Convert valgrind lackey text traces to the compact binary
+ *     trace format read by csim and test-trans (and back, with -T).
+ *
+ * Only L/S/M records are kept. Instruction fetches survive only as the pc
+ * of the accesses that follow them.
+ */
+#include "traceio.h"
+#include <unistd.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+
+#define BATCH_SIZE 4096
+
+
+void printHelp(char* argv[]) {
+    printf("Usage: %s [-hzlT] [-i <file>] [-o <file>]\n\n", argv[0]);
+    printf("Options:\n");
+    printf("-h         Print this help message.\n");
+    printf("-i <file>  Input trace, text or binary (default stdin).\n");
+    printf("-o <file>  Output file (default stdout).\n");
+    printf("-z         Compress blocks with zstd.\n");
+    printf("-l         Compress blocks with LZ4.\n");
+    printf("-T         Write lackey text instead of binary.\n\n");
+    printf("Examples:\n");
+    printf("linux>  %s -i traces/long.trace -o long.ctr\n", argv[0]);
+    printf("linux>  valgrind --tool=lackey --trace-mem=yes --log-fd=1 ./prog | %s -z -o prog.ctr\n", argv[0]);
+    printf("linux>  %s -T -i long.ctr | head\n", argv[0]);
+}
+
+
+int main(int argc, char* argv[]) {
+    char* infile = "-";
+    char* outfile = "-";
+    int codec = TRACE_CODEC_NONE;
+    bool textOut = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, ":hi:o:zlT")) != -1) {
+        switch(opt) {
+            case 'h':
+                printHelp(argv);
+                return 0;
+            case 'i':
+                infile = optarg;
+                break;
+            case 'o':
+                outfile = optarg;
+                break;
+            case 'z':
+                codec = TRACE_CODEC_ZSTD;
+                break;
+            case 'l':
+                codec = TRACE_CODEC_LZ4;
+                break;
+            case 'T':
+                textOut = true;
+                break;
+            case ':':
+                printf("Option requires an argument -- '%c'\n", optopt);
+                return 1;
+            case '?':
+                if (isprint(optopt)) {
+                    printf("Unknown option -- `%c'\n", optopt);
+                } else {
+                    printf("Unknown option character `\\x%x'\n", optopt);
+                }
+                return 1;
+            default:
+                abort();
+        }
+    }
+
+    trace_reader_t* reader = traceOpen(infile);
+    if (reader == NULL) {
+        fprintf(stderr, "Invalid or unspecified tracefile.\n");
+        return 1;
+    }
+
+    static trace_rec_t recs[BATCH_SIZE];
+    int numRecs;
+    int status = 0;
+
+    if (textOut) {
+        FILE* out = strcmp(outfile, "-") == 0 ? stdout : fopen(outfile, "w");
+        if (out == NULL) {
+            fprintf(stderr, "Unable to open %s.\n", outfile);
+            return 1;
+        }
+        addr_t pc = 0;
+        while ((numRecs = traceRead(reader, recs, BATCH_SIZE)) > 0) {
+            for (int i = 0; i < numRecs; i += 1) {
+                // Fetch lengths are not kept, only where the pc changes
+                if (recs[i].pc != pc) {
+                    pc = recs[i].pc;
+                    fprintf(out, "I  %08llx,0\n", pc);
+                }
+                fprintf(out, " %c %08llx,%d\n", recs[i].op, recs[i].addr, recs[i].size);
+            }
+        }
+        if (out != stdout) {
+            status = fclose(out);
+        }
+    } else {
+        trace_writer_t* writer = traceWriterOpen(outfile, codec);
+        if (writer == NULL) {
+            fprintf(stderr, "Unable to open %s.\n", outfile);
+            return 1;
+        }
+        while (status == 0 && (numRecs = traceRead(reader, recs, BATCH_SIZE)) > 0) {
+            status = traceWrite(writer, recs, numRecs);
+        }
+        if (traceWriterClose(writer) < 0) {
+            status = -1;
+        }
+    }
+    traceClose(reader);
+
+    if (numRecs < 0) {
+        fprintf(stderr, "%s is truncated or corrupt.\n", infile);
+        return 1;
+    }
+    if (status != 0) {
+        fprintf(stderr, "Error writing %s.\n", outfile);
+        return 1;
+    }
+    return 0;
+}
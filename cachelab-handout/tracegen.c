@@ -4,7 +4,8 @@
  * 
  * The beginning and end of each registered transpose function's trace
  * is indicated by reading from "marker" addresses. These two marker
- * addresses are recorded in file for later use.
+ * addresses, followed by the addresses of A, B and the in-place
+ * functions' scratch state, are recorded in file for later use.
  */
 
 #include <stdlib.h>
@@ -19,8 +20,9 @@
 extern trans_func_t func_list[MAX_TRANS_FUNCS];
 extern int func_counter; 
 
-/* External function from trans.c */
+/* External functions from trans.c and trans-tuned.c */
 extern void registerFunctions();
+extern void registerTunedFunctions();
 
 /* Markers used to bound trace regions of interest */
 volatile char MARKER_START, MARKER_END;
@@ -46,6 +48,17 @@ int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
     return 1;
 }
 
+/* Run function fn between the markers. An in-place function transposes
+   B, which gets a copy of A before the start marker so that the copy is
+   not part of the function's trace. */
+void run(int fn) {
+    if (func_list[fn].in_place_ptr)
+        memcpy(B, A, sizeof(int) * M * N);
+    MARKER_START = 33;
+    runTransFunction(&func_list[fn], M, N, A, B);
+    MARKER_END = 34;
+}
+
 int main(int argc, char* argv[]){
     int i;
 
@@ -72,31 +85,32 @@ int main(int argc, char* argv[]){
 
     /*  Register transpose functions */
     registerFunctions();
+    registerTunedFunctions();
 
     /* Fill A with data */
     initMatrix(M,N, A, B); 
 
-    /* Record marker addresses */
+    /* Record marker addresses, then the base addresses of A, B and the
+       in-place scratch */
     FILE* marker_fp = fopen(".marker","w");
     assert(marker_fp);
-    fprintf(marker_fp, "%llx %llx", 
+    fprintf(marker_fp, "%llx %llx %llx %llx %llx", 
             (unsigned long long int) &MARKER_START,
-            (unsigned long long int) &MARKER_END );
+            (unsigned long long int) &MARKER_END,
+            (unsigned long long int) A,
+            (unsigned long long int) B,
+            (unsigned long long int) &in_place_scratch);
     fclose(marker_fp);
 
     if (-1==selectedFunc) {
         /* Invoke registered transpose functions */
         for (i=0; i < func_counter; i++) {
-            MARKER_START = 33;
-            (*func_list[i].func_ptr)(M, N, A, B);
-            MARKER_END = 34;
+            run(i);
             if (!validate(i,M,N,A,B))
                 return i+1;
         }
     } else {
-        MARKER_START = 33;
-        (*func_list[selectedFunc].func_ptr)(M, N, A, B);
-        MARKER_END = 34;
+        run(selectedFunc);
         if (!validate(selectedFunc,M,N,A,B))
             return selectedFunc+1;
 
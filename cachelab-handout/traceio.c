@@ -0,0 +1,696 @@
+/*
+ * traceio.c - Fast reader and writer for cache lab memory traces
+ *
+ * Text traces are valgrind lackey output, where each data access line looks
+ * like " L 7ff000398,8". The parser decodes the op, hex address and decimal
+ * size by hand from a byte buffer: either the whole file mapped with mmap,
+ * or (for stdin and pipes) a block buffer that is refilled with read() and
+ * keeps any partial last line for the next round. Nothing is copied out of
+ * the mapping.
+ *
+ * Binary traces (see traceio.h for the layout) are detected by their magic
+ * and decoded block by block. Uncompressed blocks are decoded straight from
+ * the mapping; compressed blocks are first expanded into a block buffer.
+ */
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "traceio.h"
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#define STREAM_BUFSIZE (1 << 20)
+#define MAX_REC_BYTES 31 // op byte + three 10-byte varints
+#define MAX_VARINT_BYTES 10
+#define MAX_BLOCK_BYTES (TRACE_BLOCK_RECS * MAX_REC_BYTES) // largest rawLen a writer produces
+
+struct trace_reader {
+    int fd;
+    bool mapped;      // buf is an mmap of the whole file
+    bool eof;         // no more data will be read into buf
+    char* buf;
+    size_t cap;       // allocated size of buf when streaming
+    size_t len;       // bytes of valid data in buf
+    size_t limit;     // text: parse up to here, just past the last complete line
+    size_t pos;       // parse position in buf
+    addr_t pc;        // text: address of the last 'I' line
+
+    // Binary traces only
+    bool binary;
+    bool damaged;     // a block was truncated or corrupt; no more records
+    int codec;
+    const unsigned char* blk; // decoded records of the current block
+    size_t blkLen;
+    size_t blkPos;
+    addr_t prevAddr;
+    addr_t prevPc;
+    unsigned char* blkBuf;    // holds decompressed blocks
+    size_t blkBufSize;
+};
+
+struct trace_writer {
+    FILE* file;
+    int codec;
+    unsigned char* raw;   // encoded records of the block being built
+    size_t rawLen;
+    unsigned numRecs;
+    addr_t prevAddr;
+    addr_t prevPc;
+    unsigned char* out;   // compressed block
+    size_t outSize;
+};
+
+/* Hex digit values, -1 for anything else */
+static signed char hexval[256];
+static bool hexvalReady = false;
+
+
+static void initHexTable(void) {
+    hexvalReady = true;
+    memset(hexval, -1, sizeof(hexval));
+    for (int c = '0'; c <= '9'; c += 1) {
+        hexval[c] = c - '0';
+    }
+    for (int c = 'a'; c <= 'f'; c += 1) {
+        hexval[c] = c - 'a' + 10;
+        hexval[c - 'a' + 'A'] = c - 'a' + 10;
+    }
+}
+
+
+static inline uint32_t getU32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+static inline void putU32(unsigned char* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+
+/*
+Returns a pointer to the next n bytes of input and consumes them, or NULL if
+the input ends first. Streams grow and refill buf as needed.
+*/
+static const unsigned char* fetch(trace_reader_t* reader, size_t n) {
+    if (!reader->mapped && reader->len - reader->pos < n) {
+        size_t rest = reader->len - reader->pos;
+        memmove(reader->buf, reader->buf + reader->pos, rest);
+        reader->len = rest;
+        reader->pos = 0;
+        if (n > reader->cap) {
+            char* bigger = realloc(reader->buf, n);
+            if (bigger == NULL) {
+                return NULL;
+            }
+            reader->buf = bigger;
+            reader->cap = n;
+        }
+        while (reader->len < n && !reader->eof) {
+            ssize_t got = read(reader->fd, reader->buf + reader->len, reader->cap - reader->len);
+            if (got <= 0) {
+                reader->eof = true;
+            } else {
+                reader->len += got;
+            }
+        }
+    }
+    if (reader->len - reader->pos < n) {
+        return NULL;
+    }
+    const unsigned char* p = (const unsigned char*) reader->buf + reader->pos;
+    reader->pos += n;
+    return p;
+}
+
+
+static bool codecSupported(int codec) {
+    switch (codec) {
+        case TRACE_CODEC_NONE:
+            return true;
+#ifdef HAVE_ZSTD
+        case TRACE_CODEC_ZSTD:
+            return true;
+#endif
+#ifdef HAVE_LZ4
+        case TRACE_CODEC_LZ4:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+
+/*
+Listens on a Unix stream socket at path, replacing a stale socket left
+there, and returns the first connection accepted, or -1. The socket file
+is removed again once the producer is connected.
+*/
+static int acceptUnix(const char* path) {
+    struct sockaddr_un sa;
+    struct stat st;
+
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        return -1;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, path);
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return -1;
+    }
+    if (bind(listener, (struct sockaddr*) &sa, sizeof(sa)) < 0 || listen(listener, 1) < 0) {
+        close(listener);
+        return -1;
+    }
+    fprintf(stderr, "Waiting for a trace on %s\n", path);
+    int fd = accept(listener, NULL, NULL);
+    close(listener);
+    unlink(path);
+    return fd;
+}
+
+
+trace_reader_t* traceOpen(const char* path) {
+    struct stat st;
+    trace_reader_t* reader = calloc(1, sizeof(trace_reader_t));
+    if (reader == NULL) {
+        return NULL;
+    }
+    if (!hexvalReady) {
+        initHexTable();
+    }
+
+    if (strcmp(path, "-") == 0) {
+        reader->fd = STDIN_FILENO;
+    } else if (strncmp(path, "unix:", 5) == 0) {
+        if ((reader->fd = acceptUnix(path + 5)) < 0) {
+            free(reader);
+            return NULL;
+        }
+    } else if ((reader->fd = open(path, O_RDONLY)) < 0) {
+        free(reader);
+        return NULL;
+    }
+
+    // Regular, non-empty files are mapped; everything else is streamed
+    if (fstat(reader->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            reader->mapped = true;
+            reader->eof = true;
+            reader->buf = map;
+            reader->len = st.st_size;
+            reader->limit = st.st_size;
+        }
+    }
+    if (!reader->mapped) {
+        reader->buf = malloc(STREAM_BUFSIZE);
+        reader->cap = STREAM_BUFSIZE;
+        if (reader->buf == NULL) {
+            traceClose(reader);
+            return NULL;
+        }
+    }
+
+    // Binary traces start with the magic; anything else is parsed as text
+    const unsigned char* hdr = fetch(reader, TRACE_HEADER_SIZE);
+    if (hdr != NULL && memcmp(hdr, TRACE_MAGIC, TRACE_MAGIC_LEN) == 0) {
+        reader->binary = true;
+        reader->codec = hdr[TRACE_MAGIC_LEN];
+        if (!codecSupported(reader->codec)) {
+            fprintf(stderr, "Trace uses compression codec %d, which this build does not support.\n",
+                    reader->codec);
+            traceClose(reader);
+            return NULL;
+        }
+    } else {
+        reader->pos = 0;
+        if (!reader->mapped) {
+            // Text stream: hold back the partial last line, as refill does
+            reader->limit = reader->len;
+            while (!reader->eof && reader->limit > 0 && reader->buf[reader->limit - 1] != '\n') {
+                reader->limit -= 1;
+            }
+        }
+    }
+    return reader;
+}
+
+
+/*
+Moves the unparsed tail of the stream buffer to the front and reads more
+data behind it. Returns false once the stream is exhausted.
+*/
+static bool refill(trace_reader_t* reader) {
+    if (reader->eof) {
+        return false;
+    }
+    size_t rest = reader->len - reader->pos;
+    memmove(reader->buf, reader->buf + reader->pos, rest);
+    reader->len = rest;
+    reader->pos = 0;
+
+    while (reader->len < reader->cap) {
+        ssize_t n = read(reader->fd, reader->buf + reader->len, reader->cap - reader->len);
+        if (n <= 0) {
+            reader->eof = true;
+            break;
+        }
+        reader->len += n;
+        // A full line is all the parser needs to make progress
+        if (memchr(reader->buf + reader->len - n, '\n', n) != NULL) {
+            break;
+        }
+    }
+
+    // Hold back a partial last line until the rest of it arrives
+    reader->limit = reader->len;
+    if (!reader->eof) {
+        while (reader->limit > 0 && reader->buf[reader->limit - 1] != '\n') {
+            reader->limit -= 1;
+        }
+        if (reader->limit == 0) {
+            reader->limit = reader->len; // a single line longer than the buffer
+        }
+    }
+    return reader->len > 0;
+}
+
+
+/* Parses hex digits at *p, advancing *p */
+static inline addr_t parseHex(const char** p, const char* end) {
+    addr_t v = 0;
+    while (*p < end && hexval[(unsigned char) **p] >= 0) {
+        v = (v << 4) | hexval[(unsigned char) **p];
+        *p += 1;
+    }
+    return v;
+}
+
+
+/*
+Parses one line starting at p (bounded by end). Returns a pointer just past
+the line's newline, and sets *ok if the line was a data access. An 'I' line
+updates *pc instead.
+*/
+static inline const char* parseLine(const char* p, const char* end, trace_rec_t* rec, bool* ok, addr_t* pc) {
+    *ok = false;
+    while (p < end && *p == ' ') {
+        p += 1;
+    }
+    if (p < end && *p == 'I') {
+        p += 1;
+        while (p < end && *p == ' ') {
+            p += 1;
+        }
+        *pc = parseHex(&p, end);
+    } else if (p < end && (*p == 'L' || *p == 'S' || *p == 'M')) {
+        rec->op = *p;
+        p += 1;
+        while (p < end && *p == ' ') {
+            p += 1;
+        }
+        const char* digits = p;
+        addr_t addr = parseHex(&p, end);
+        if (p > digits && p < end && *p == ',') {
+            int size = 0;
+            p += 1;
+            while (p < end && *p >= '0' && *p <= '9') {
+                size = size * 10 + (*p - '0');
+                p += 1;
+            }
+            rec->addr = addr;
+            rec->pc = *pc;
+            rec->size = size;
+            *ok = true;
+        }
+    }
+    // Skip the rest of the line, including anything malformed
+    const char* nl = memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+
+static int readText(trace_reader_t* reader, trace_rec_t* recs, int max) {
+    int n = 0;
+    bool ok;
+
+    while (n < max) {
+        const char* p = reader->buf + reader->pos;
+        const char* end = reader->buf + reader->limit;
+
+        while (n < max && p < end) {
+            p = parseLine(p, end, &recs[n], &ok, &reader->pc);
+            n += ok;
+        }
+        reader->pos = p - reader->buf;
+
+        if (n < max && (reader->mapped || !refill(reader))) {
+            break;
+        }
+    }
+    return n;
+}
+
+
+/*
+Loads the next block of a binary trace into blk, decompressing it if
+needed. Returns false at the end of the trace or on a damaged block,
+setting damaged in the latter case.
+*/
+static bool nextBlock(trace_reader_t* reader) {
+    const unsigned char* hdr = fetch(reader, TRACE_BLOCK_HEADER_SIZE);
+    if (hdr == NULL) {
+        if (reader->pos < reader->len) {
+            fprintf(stderr, "Truncated trace block.\n");
+            reader->damaged = true;
+        }
+        return false;
+    }
+    size_t rawLen = getU32(hdr + 4);
+    size_t storedLen = getU32(hdr + 8);
+    // Blocks are only stored compressed when that makes them smaller
+    if (rawLen > MAX_BLOCK_BYTES || storedLen > rawLen) {
+        fprintf(stderr, "Corrupt trace block header.\n");
+        reader->damaged = true;
+        return false;
+    }
+    const unsigned char* data = fetch(reader, storedLen);
+    if (data == NULL) {
+        fprintf(stderr, "Truncated trace block.\n");
+        reader->damaged = true;
+        return false;
+    }
+
+    if (storedLen == rawLen) {
+        // Stored as is. When streaming, data lives in buf only until the
+        // next fetch, which does not happen before the block is consumed.
+        reader->blk = data;
+    } else {
+        if (rawLen > reader->blkBufSize) {
+            unsigned char* bigger = realloc(reader->blkBuf, rawLen);
+            if (bigger == NULL) {
+                fprintf(stderr, "Out of memory for trace block.\n");
+                reader->damaged = true;
+                return false;
+            }
+            reader->blkBuf = bigger;
+            reader->blkBufSize = rawLen;
+        }
+        size_t got = 0;
+        switch (reader->codec) {
+#ifdef HAVE_ZSTD
+            case TRACE_CODEC_ZSTD: {
+                size_t r = ZSTD_decompress(reader->blkBuf, rawLen, data, storedLen);
+                got = ZSTD_isError(r) ? 0 : r;
+                break;
+            }
+#endif
+#ifdef HAVE_LZ4
+            case TRACE_CODEC_LZ4: {
+                int r = LZ4_decompress_safe((const char*) data, (char*) reader->blkBuf,
+                                            storedLen, rawLen);
+                got = r < 0 ? 0 : r;
+                break;
+            }
+#endif
+            default:
+                break;
+        }
+        if (got != rawLen) {
+            fprintf(stderr, "Corrupt compressed trace block.\n");
+            reader->damaged = true;
+            return false;
+        }
+        reader->blk = reader->blkBuf;
+    }
+    reader->blkLen = rawLen;
+    reader->blkPos = 0;
+    reader->prevAddr = 0;
+    reader->prevPc = 0;
+    return true;
+}
+
+
+/*
+Decodes a LEB128 varint at *p into *v, advancing *p. Returns false if it
+runs past end or past MAX_VARINT_BYTES.
+*/
+static inline bool getVarint(const unsigned char** p, const unsigned char* end, addr_t* v) {
+    addr_t val = 0;
+    for (int shift = 0; *p < end && shift < 7 * MAX_VARINT_BYTES; shift += 7) {
+        unsigned char byte = **p;
+        *p += 1;
+        val |= (addr_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *v = val;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static int readBinary(trace_reader_t* reader, trace_rec_t* recs, int max) {
+    static const char opChar[4] = {'L', 'S', 'M', 'L'};
+    int n = 0;
+
+    if (reader->damaged) {
+        return -1;
+    }
+    while (n < max && !reader->damaged) {
+        if (reader->blkPos >= reader->blkLen && !nextBlock(reader)) {
+            break;
+        }
+        const unsigned char* p = reader->blk + reader->blkPos;
+        const unsigned char* end = reader->blk + reader->blkLen;
+        addr_t prev = reader->prevAddr;
+        addr_t prevPc = reader->prevPc;
+
+        while (n < max && p < end) {
+            unsigned char opByte = *p++;
+            addr_t zz, size = 0, pcDelta = 0;
+            if (!getVarint(&p, end, &zz) ||
+                ((opByte & TRACE_SIZE_EXPLICIT) && !getVarint(&p, end, &size)) ||
+                ((opByte & TRACE_PC_DELTA) && !getVarint(&p, end, &pcDelta))) {
+                fprintf(stderr, "Corrupt trace block.\n");
+                reader->damaged = true;
+                p = end;
+                break;
+            }
+            prev += (zz >> 1) ^ -(zz & 1); // undo zigzag
+            recs[n].op = opChar[opByte & TRACE_OP_MASK];
+            recs[n].addr = prev;
+            if (opByte & TRACE_SIZE_EXPLICIT) {
+                recs[n].size = size;
+            } else {
+                recs[n].size = 1 << ((opByte >> TRACE_SIZE_SHIFT) & 3);
+            }
+            prevPc += (pcDelta >> 1) ^ -(pcDelta & 1);
+            recs[n].pc = prevPc;
+            n += 1;
+        }
+        reader->blkPos = p - reader->blk;
+        reader->prevAddr = prev;
+        reader->prevPc = prevPc;
+    }
+    // Records decoded before the damage are still handed out; the next call fails
+    return n == 0 && reader->damaged ? -1 : n;
+}
+
+
+bool traceIsStream(const trace_reader_t* reader) {
+    return !reader->mapped;
+}
+
+
+int traceRead(trace_reader_t* reader, trace_rec_t* recs, int max) {
+    return reader->binary ? readBinary(reader, recs, max) : readText(reader, recs, max);
+}
+
+
+void traceClose(trace_reader_t* reader) {
+    if (reader->mapped) {
+        munmap(reader->buf, reader->len);
+    } else {
+        free(reader->buf);
+    }
+    if (reader->fd != STDIN_FILENO) {
+        close(reader->fd);
+    }
+    free(reader->blkBuf);
+    free(reader);
+}
+
+
+trace_writer_t* traceWriterOpen(const char* path, int codec) {
+    if (!codecSupported(codec)) {
+        fprintf(stderr, "Compression codec %d is not supported by this build.\n", codec);
+        return NULL;
+    }
+    trace_writer_t* writer = calloc(1, sizeof(trace_writer_t));
+    if (writer == NULL) {
+        return NULL;
+    }
+    writer->codec = codec;
+    writer->raw = malloc(TRACE_BLOCK_RECS * MAX_REC_BYTES);
+    writer->file = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if (writer->raw == NULL || writer->file == NULL) {
+        free(writer->raw);
+        free(writer);
+        return NULL;
+    }
+
+    unsigned char hdr[TRACE_HEADER_SIZE] = {0};
+    memcpy(hdr, TRACE_MAGIC, TRACE_MAGIC_LEN);
+    hdr[TRACE_MAGIC_LEN] = codec;
+    fwrite(hdr, 1, sizeof(hdr), writer->file);
+    return writer;
+}
+
+
+/* Compresses (if enabled and worthwhile) and writes the pending block */
+static int flushBlock(trace_writer_t* writer) {
+    const unsigned char* data = writer->raw;
+    size_t storedLen = writer->rawLen;
+
+    if (writer->numRecs == 0) {
+        return 0;
+    }
+    switch (writer->codec) {
+#ifdef HAVE_ZSTD
+        case TRACE_CODEC_ZSTD: {
+            size_t bound = ZSTD_compressBound(writer->rawLen);
+            if (bound > writer->outSize) {
+                free(writer->out);
+                writer->out = malloc(bound);
+                writer->outSize = writer->out ? bound : 0;
+            }
+            if (writer->out != NULL) {
+                size_t r = ZSTD_compress(writer->out, bound, writer->raw, writer->rawLen, 3);
+                if (!ZSTD_isError(r) && r < storedLen) {
+                    data = writer->out;
+                    storedLen = r;
+                }
+            }
+            break;
+        }
+#endif
+#ifdef HAVE_LZ4
+        case TRACE_CODEC_LZ4: {
+            size_t bound = LZ4_compressBound(writer->rawLen);
+            if (bound > writer->outSize) {
+                free(writer->out);
+                writer->out = malloc(bound);
+                writer->outSize = writer->out ? bound : 0;
+            }
+            if (writer->out != NULL) {
+                int r = LZ4_compress_default((const char*) writer->raw, (char*) writer->out,
+                                             writer->rawLen, bound);
+                if (r > 0 && (size_t) r < storedLen) {
+                    data = writer->out;
+                    storedLen = r;
+                }
+            }
+            break;
+        }
+#endif
+        default:
+            break;
+    }
+
+    unsigned char hdr[TRACE_BLOCK_HEADER_SIZE];
+    putU32(hdr, writer->numRecs);
+    putU32(hdr + 4, writer->rawLen);
+    putU32(hdr + 8, storedLen);
+    if (fwrite(hdr, 1, sizeof(hdr), writer->file) != sizeof(hdr) ||
+        fwrite(data, 1, storedLen, writer->file) != storedLen) {
+        return -1;
+    }
+    writer->rawLen = 0;
+    writer->numRecs = 0;
+    writer->prevAddr = 0;
+    writer->prevPc = 0;
+    return 0;
+}
+
+
+/* Appends v as a LEB128 varint at p, returns the new end */
+static inline unsigned char* putVarint(unsigned char* p, addr_t v) {
+    while (v >= 0x80) {
+        *p++ = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+
+int traceWrite(trace_writer_t* writer, const trace_rec_t* recs, int n) {
+    for (int i = 0; i < n; i += 1) {
+        unsigned char* p = writer->raw + writer->rawLen;
+        int op = recs[i].op == 'S' ? 1 : recs[i].op == 'M' ? 2 : 0;
+        int size = recs[i].size;
+        int log2 = size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : size == 8 ? 3 : -1;
+        addr_t delta = recs[i].addr - writer->prevAddr;
+        addr_t pcDelta = recs[i].pc - writer->prevPc;
+
+        *p++ = op | (log2 >= 0 ? log2 << TRACE_SIZE_SHIFT : TRACE_SIZE_EXPLICIT) |
+               (pcDelta != 0 ? TRACE_PC_DELTA : 0);
+        p = putVarint(p, (delta << 1) ^ -(delta >> 63)); // zigzag
+        if (log2 < 0) {
+            p = putVarint(p, size);
+        }
+        if (pcDelta != 0) {
+            p = putVarint(p, (pcDelta << 1) ^ -(pcDelta >> 63));
+        }
+        writer->rawLen = p - writer->raw;
+        writer->prevAddr = recs[i].addr;
+        writer->prevPc = recs[i].pc;
+        writer->numRecs += 1;
+        if (writer->numRecs == TRACE_BLOCK_RECS && flushBlock(writer) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+int traceWriterClose(trace_writer_t* writer) {
+    int status = flushBlock(writer);
+    if (writer->file != stdout) {
+        if (fclose(writer->file) != 0) {
+            status = -1;
+        }
+    } else if (fflush(stdout) != 0) {
+        status = -1;
+    }
+    free(writer->raw);
+    free(writer->out);
+    free(writer);
+    return status;
+}
@@ -0,0 +1,93 @@
+/*
+ * traceio.h - Fast reader and writer for cache lab memory traces
+ *
+ * Two formats are read transparently: valgrind lackey text output, and a
+ * compact binary format written by traceWriter* (see trace2bin):
+ *
+ *   header  16 bytes: "CLTRACE1", codec byte, 7 reserved zero bytes
+ *   block   u32 numRecs, u32 rawLen, u32 storedLen (little endian),
+ *           then storedLen bytes: the rawLen bytes of records, compressed
+ *           with the header's codec unless storedLen == rawLen
+ *   record  op byte: bits 0-1 op (0 L, 1 S, 2 M), bits 2-3 log2(size),
+ *           or bit 4 set if the size is not 1/2/4/8 and follows as a varint;
+ *           bit 5 set if the record's pc differs from the previous one's;
+ *           then the address minus the previous record's address, zigzag
+ *           encoded as a LEB128 varint, the size varint if bit 4 is set,
+ *           and the zigzag varint pc delta if bit 5 is set. The previous
+ *           address and pc are 0 at the start of every block, so blocks
+ *           decode independently.
+ */
+
+#ifndef TRACEIO_H
+#define TRACEIO_H
+
+#include <stdbool.h>
+
+typedef unsigned long long addr_t;
+
+/* One decoded data access. Instruction ('I') lines are never returned. */
+typedef struct trace_rec {
+    addr_t addr;
+    addr_t pc; /* address of the last instruction fetch before it, 0 if unknown */
+    int size;  /* access size in bytes */
+    char op;   /* 'L', 'S' or 'M' */
+} trace_rec_t;
+
+typedef struct trace_reader trace_reader_t;
+typedef struct trace_writer trace_writer_t;
+
+#define TRACE_MAGIC "CLTRACE1"
+#define TRACE_MAGIC_LEN 8
+#define TRACE_HEADER_SIZE 16
+#define TRACE_BLOCK_HEADER_SIZE 12
+#define TRACE_BLOCK_RECS 65536     /* records per block written */
+#define TRACE_OP_MASK 0x3
+#define TRACE_SIZE_SHIFT 2
+#define TRACE_SIZE_EXPLICIT 0x10
+#define TRACE_PC_DELTA 0x20
+
+/* Block compression codecs. zstd and LZ4 need HAVE_ZSTD / HAVE_LZ4. */
+#define TRACE_CODEC_NONE 0
+#define TRACE_CODEC_ZSTD 1
+#define TRACE_CODEC_LZ4  2
+
+/*
+ * traceOpen - Open a text or binary trace for reading. Regular files are
+ *     mapped into memory and parsed in place; "-" reads stdin, and pipes
+ *     or other non-seekable files are read in large blocks. "unix:<path>"
+ *     listens on a Unix socket at <path> and reads from the first process
+ *     to connect (e.g. socat - UNIX-CONNECT:<path>). Returns NULL on error.
+ */
+trace_reader_t* traceOpen(const char* path);
+
+/*
+ * traceIsStream - Whether the trace arrives as it is produced (stdin, a
+ *     pipe or a socket) rather than from a file mapped in whole
+ */
+bool traceIsStream(const trace_reader_t* reader);
+
+/*
+ * traceRead - Decode up to max records into recs. Lines that are not
+ *     data accesses (instruction fetches, valgrind banners) are skipped,
+ *     but each access carries the address of the fetch before it as pc.
+ *     Returns the number of records decoded, 0 at end of trace, or -1
+ *     once a binary trace turns out to be truncated or corrupt.
+ */
+int traceRead(trace_reader_t* reader, trace_rec_t* recs, int max);
+
+/* traceClose - Release the reader and its mapping or buffer */
+void traceClose(trace_reader_t* reader);
+
+/*
+ * traceWriterOpen - Create a binary trace at path ("-" for stdout) whose
+ *     blocks are compressed with codec. Returns NULL on error.
+ */
+trace_writer_t* traceWriterOpen(const char* path, int codec);
+
+/* traceWrite - Append n records. Returns 0 on success, -1 on error. */
+int traceWrite(trace_writer_t* writer, const trace_rec_t* recs, int n);
+
+/* traceWriterClose - Flush the last block and close. Returns 0 or -1. */
+int traceWriterClose(trace_writer_t* writer);
+
+#endif /* TRACEIO_H */
@@ -0,0 +1,375 @@
+/*
+ * trans-tuned.c - Transposes generated by test-trans -G
+ *
+ * Do not edit; rerun test-trans -G instead. Each function is the schedule
+ * (schedule.h) with the fewest misses on its shape for s=5, E=1, b=5,
+ * and transpose_autotuned picks one by shape.
+ */
+#include "cachelab.h"
+
+/* 32 x 32: plain 2 x 8, column tiles, by rows, diagonal deferred; 286 misses */
+static void tuned_32x32(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, i1, j1, diag = 0;
+
+    for (j = 0; j < M; j += 8) {
+        for (i = 0; i < N; i += 2) {
+            for (i1 = i; i1 < i + 2 && i1 < N; i1++) {
+                for (j1 = j; j1 < j + 8 && j1 < M; j1++) {
+                    if (i1 == j1) {
+                        diag = A[i1][j1];
+                    } else {
+                        B[j1][i1] = A[i1][j1];
+                    }
+                }
+                if (i1 >= j && i1 < j + 8 && i1 < M) {
+                    B[i1][i1] = diag;
+                }
+            }
+        }
+    }
+}
+
+/* 64 x 64: halves 8 x 8, row tiles; 1170 misses */
+static void tuned_64x64(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, k, t0, t1, t2, t3, t4, t5, t6, t7;
+
+    for (i = 0; i + 8 <= N; i += 8) {
+        for (j = 0; j + 8 <= M; j += 8) {
+            for (k = i; k < i + 4; k++) {
+                t0 = A[k][j];
+                t1 = A[k][j + 1];
+                t2 = A[k][j + 2];
+                t3 = A[k][j + 3];
+                t4 = A[k][j + 4];
+                t5 = A[k][j + 5];
+                t6 = A[k][j + 6];
+                t7 = A[k][j + 7];
+                B[j][k] = t0;
+                B[j + 1][k] = t1;
+                B[j + 2][k] = t2;
+                B[j + 3][k] = t3;
+                B[j][k + 4] = t4;
+                B[j + 1][k + 4] = t5;
+                B[j + 2][k + 4] = t6;
+                B[j + 3][k + 4] = t7;
+            }
+            for (k = j; k < j + 4; k++) {
+                t0 = A[i + 4][k];
+                t1 = A[i + 5][k];
+                t2 = A[i + 6][k];
+                t3 = A[i + 7][k];
+                t4 = B[k][i + 4];
+                t5 = B[k][i + 5];
+                t6 = B[k][i + 6];
+                t7 = B[k][i + 7];
+                B[k][i + 4] = t0;
+                B[k][i + 5] = t1;
+                B[k][i + 6] = t2;
+                B[k][i + 7] = t3;
+                B[k + 4][i] = t4;
+                B[k + 4][i + 1] = t5;
+                B[k + 4][i + 2] = t6;
+                B[k + 4][i + 3] = t7;
+            }
+            for (k = j + 4; k < j + 8; k++) {
+                t0 = A[i + 4][k];
+                t1 = A[i + 5][k];
+                t2 = A[i + 6][k];
+                t3 = A[i + 7][k];
+                B[k][i + 4] = t0;
+                B[k][i + 5] = t1;
+                B[k][i + 6] = t2;
+                B[k][i + 7] = t3;
+            }
+        }
+    }
+    for (i = 0; i < N; i++) {
+        for (j = M - M % 8; j < M; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+    for (i = N - N % 8; i < N; i++) {
+        for (j = 0; j < M - M % 8; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+}
+
+/* 61 x 67: staged 24 x 8, row tiles; 1755 misses */
+static void tuned_61x67(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, i1, j1, t0, t1, t2, t3, t4, t5, t6, t7;
+
+    for (i = 0; i < N; i += 24) {
+        for (j = 0; j < M; j += 8) {
+            for (i1 = i; i1 < i + 24 && i1 < N; i1++) {
+                if (j + 8 <= M) {
+                    t0 = A[i1][j];
+                    t1 = A[i1][j + 1];
+                    t2 = A[i1][j + 2];
+                    t3 = A[i1][j + 3];
+                    t4 = A[i1][j + 4];
+                    t5 = A[i1][j + 5];
+                    t6 = A[i1][j + 6];
+                    t7 = A[i1][j + 7];
+                    B[j][i1] = t0;
+                    B[j + 1][i1] = t1;
+                    B[j + 2][i1] = t2;
+                    B[j + 3][i1] = t3;
+                    B[j + 4][i1] = t4;
+                    B[j + 5][i1] = t5;
+                    B[j + 6][i1] = t6;
+                    B[j + 7][i1] = t7;
+                } else {
+                    for (j1 = j; j1 < M; j1++) {
+                        B[j1][i1] = A[i1][j1];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* 48 x 48: staged 2 x 8, column tiles; 646 misses */
+static void tuned_48x48(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, i1, j1, t0, t1, t2, t3, t4, t5, t6, t7;
+
+    for (j = 0; j < M; j += 8) {
+        for (i = 0; i < N; i += 2) {
+            for (i1 = i; i1 < i + 2 && i1 < N; i1++) {
+                if (j + 8 <= M) {
+                    t0 = A[i1][j];
+                    t1 = A[i1][j + 1];
+                    t2 = A[i1][j + 2];
+                    t3 = A[i1][j + 3];
+                    t4 = A[i1][j + 4];
+                    t5 = A[i1][j + 5];
+                    t6 = A[i1][j + 6];
+                    t7 = A[i1][j + 7];
+                    B[j][i1] = t0;
+                    B[j + 1][i1] = t1;
+                    B[j + 2][i1] = t2;
+                    B[j + 3][i1] = t3;
+                    B[j + 4][i1] = t4;
+                    B[j + 5][i1] = t5;
+                    B[j + 6][i1] = t6;
+                    B[j + 7][i1] = t7;
+                } else {
+                    for (j1 = j; j1 < M; j1++) {
+                        B[j1][i1] = A[i1][j1];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* 96 x 96: staged 2 x 8, column tiles; 2558 misses */
+static void tuned_96x96(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, i1, j1, t0, t1, t2, t3, t4, t5, t6, t7;
+
+    for (j = 0; j < M; j += 8) {
+        for (i = 0; i < N; i += 2) {
+            for (i1 = i; i1 < i + 2 && i1 < N; i1++) {
+                if (j + 8 <= M) {
+                    t0 = A[i1][j];
+                    t1 = A[i1][j + 1];
+                    t2 = A[i1][j + 2];
+                    t3 = A[i1][j + 3];
+                    t4 = A[i1][j + 4];
+                    t5 = A[i1][j + 5];
+                    t6 = A[i1][j + 6];
+                    t7 = A[i1][j + 7];
+                    B[j][i1] = t0;
+                    B[j + 1][i1] = t1;
+                    B[j + 2][i1] = t2;
+                    B[j + 3][i1] = t3;
+                    B[j + 4][i1] = t4;
+                    B[j + 5][i1] = t5;
+                    B[j + 6][i1] = t6;
+                    B[j + 7][i1] = t7;
+                } else {
+                    for (j1 = j; j1 < M; j1++) {
+                        B[j1][i1] = A[i1][j1];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* 100 x 37: staged 2 x 4, column tiles; 1422 misses */
+static void tuned_100x37(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, i1, j1, t0, t1, t2, t3;
+
+    for (j = 0; j < M; j += 4) {
+        for (i = 0; i < N; i += 2) {
+            for (i1 = i; i1 < i + 2 && i1 < N; i1++) {
+                if (j + 4 <= M) {
+                    t0 = A[i1][j];
+                    t1 = A[i1][j + 1];
+                    t2 = A[i1][j + 2];
+                    t3 = A[i1][j + 3];
+                    B[j][i1] = t0;
+                    B[j + 1][i1] = t1;
+                    B[j + 2][i1] = t2;
+                    B[j + 3][i1] = t3;
+                } else {
+                    for (j1 = j; j1 < M; j1++) {
+                        B[j1][i1] = A[i1][j1];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* 37 x 100: plain 4 x 2, row tiles, by columns; 1591 misses */
+static void tuned_37x100(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, i1, j1;
+
+    for (i = 0; i < N; i += 4) {
+        for (j = 0; j < M; j += 2) {
+            for (j1 = j; j1 < j + 2 && j1 < M; j1++) {
+                for (i1 = i; i1 < i + 4 && i1 < N; i1++) {
+                    B[j1][i1] = A[i1][j1];
+                }
+            }
+        }
+    }
+}
+
+/* 128 x 128: staged 2 x 2, column tiles; 10690 misses */
+static void tuned_128x128(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, i1, j1, t0, t1;
+
+    for (j = 0; j < M; j += 2) {
+        for (i = 0; i < N; i += 2) {
+            for (i1 = i; i1 < i + 2 && i1 < N; i1++) {
+                if (j + 2 <= M) {
+                    t0 = A[i1][j];
+                    t1 = A[i1][j + 1];
+                    B[j][i1] = t0;
+                    B[j + 1][i1] = t1;
+                } else {
+                    for (j1 = j; j1 < M; j1++) {
+                        B[j1][i1] = A[i1][j1];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* 255 x 255: plain 32 x 2, column tiles, by columns; 74389 misses */
+static void tuned_255x255(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, i1, j1;
+
+    for (j = 0; j < M; j += 2) {
+        for (i = 0; i < N; i += 32) {
+            for (j1 = j; j1 < j + 2 && j1 < M; j1++) {
+                for (i1 = i; i1 < i + 32 && i1 < N; i1++) {
+                    B[j1][i1] = A[i1][j1];
+                }
+            }
+        }
+    }
+}
+
+/* 256 x 256: staged 2 x 8, row tiles; 73730 misses */
+static void tuned_256x256(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, i1, j1, t0, t1, t2, t3, t4, t5, t6, t7;
+
+    for (i = 0; i < N; i += 2) {
+        for (j = 0; j < M; j += 8) {
+            for (i1 = i; i1 < i + 2 && i1 < N; i1++) {
+                if (j + 8 <= M) {
+                    t0 = A[i1][j];
+                    t1 = A[i1][j + 1];
+                    t2 = A[i1][j + 2];
+                    t3 = A[i1][j + 3];
+                    t4 = A[i1][j + 4];
+                    t5 = A[i1][j + 5];
+                    t6 = A[i1][j + 6];
+                    t7 = A[i1][j + 7];
+                    B[j][i1] = t0;
+                    B[j + 1][i1] = t1;
+                    B[j + 2][i1] = t2;
+                    B[j + 3][i1] = t3;
+                    B[j + 4][i1] = t4;
+                    B[j + 5][i1] = t5;
+                    B[j + 6][i1] = t6;
+                    B[j + 7][i1] = t7;
+                } else {
+                    for (j1 = j; j1 < M; j1++) {
+                        B[j1][i1] = A[i1][j1];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* Any other shape: plain 8 x 8, row tiles, by rows, diagonal deferred */
+static void tuned_default(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, i1, j1, diag = 0;
+
+    for (i = 0; i < N; i += 8) {
+        for (j = 0; j < M; j += 8) {
+            for (i1 = i; i1 < i + 8 && i1 < N; i1++) {
+                for (j1 = j; j1 < j + 8 && j1 < M; j1++) {
+                    if (i1 == j1) {
+                        diag = A[i1][j1];
+                    } else {
+                        B[j1][i1] = A[i1][j1];
+                    }
+                }
+                if (i1 >= j && i1 < j + 8 && i1 < M) {
+                    B[i1][i1] = diag;
+                }
+            }
+        }
+    }
+}
+
+char transpose_autotuned_desc[] = "Auto-tuned schedule per shape";
+void transpose_autotuned(int M, int N, int A[N][M], int B[M][N])
+{
+    if (M == 32 && N == 32)
+        tuned_32x32(M, N, A, B);
+    else if (M == 64 && N == 64)
+        tuned_64x64(M, N, A, B);
+    else if (M == 61 && N == 67)
+        tuned_61x67(M, N, A, B);
+    else if (M == 48 && N == 48)
+        tuned_48x48(M, N, A, B);
+    else if (M == 96 && N == 96)
+        tuned_96x96(M, N, A, B);
+    else if (M == 100 && N == 37)
+        tuned_100x37(M, N, A, B);
+    else if (M == 37 && N == 100)
+        tuned_37x100(M, N, A, B);
+    else if (M == 128 && N == 128)
+        tuned_128x128(M, N, A, B);
+    else if (M == 255 && N == 255)
+        tuned_255x255(M, N, A, B);
+    else if (M == 256 && N == 256)
+        tuned_256x256(M, N, A, B);
+    else
+        tuned_default(M, N, A, B);
+}
+
+void registerTunedFunctions()
+{
+    registerTransFunction(transpose_autotuned, transpose_autotuned_desc);
+}
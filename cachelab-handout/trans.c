@@ -3,6 +3,9 @@
  *
  * Each transpose function must have a prototype of the form:
  * void trans(int M, int N, int A[N][M], int B[M][N]);
+ * or, for in-place functions registered with registerInPlaceFunction,
+ * void trans(int M, int N, int A[N][M]);
+ * which leave the M x N transpose in A's memory.
  *
  * A transpose function is evaluated by counting the number of misses
  * on a 1KB direct mapped cache with a block size of 32 bytes.
@@ -11,6 +14,9 @@
 #include "cachelab.h"
 
 int is_transpose(int M, int N, int A[N][M], int B[M][N]);
+void transpose_staged(int M, int N, int A[N][M], int B[M][N]);
+void transpose_halves(int M, int N, int A[N][M], int B[M][N]);
+void transpose_tuned(int M, int N, int A[N][M], int B[M][N]);
 
 /* 
  * transpose_submit - This is the solution transpose function that you
@@ -22,98 +28,398 @@ int is_transpose(int M, int N, int A[N][M], int B[M][N]);
 char transpose_submit_desc[] = "Transpose submission";
 void transpose_submit(int M, int N, int A[N][M], int B[M][N])
 {   
-    int i, j, i1, j1;
-    int blkSize32 = 8;
-    int blkSize64 = 4;
-    int blkSize61 = 8;
+    if (M == 32 && N == 32) {
+        transpose_staged(M, N, A, B);
+    } else if (M == 64 && N == 64) {
+        transpose_halves(M, N, A, B);
+    } else {
+        transpose_tuned(M, N, A, B);
+    }
+}
 
-    if (M == 32) {
-        // iteration thru blocks
-        for (j = 0; j < M; j += blkSize32) {
-            for (i = 0; i < M; i += blkSize32) {
+/* 
+ * You can define additional transpose functions below. We've defined
+ * a simple one below to help you get started. 
+ */ 
 
-                // iteration thru row of blocks
-                for (i1 = i; i1 < i + blkSize32; i1 += 1) {
+/* 
+ * trans - A simple baseline transpose function, not optimized for the cache.
+ */
+char trans_desc[] = "Simple row-wise scan transpose";
+void trans(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, tmp;
 
-                    // iteration thru col of blocks
-                    for (j1 = j; j1 < j + blkSize32; j1 += 1) {
+    for (i = 0; i < N; i++) {
+        for (j = 0; j < M; j++) {
+            tmp = A[i][j];
+            B[j][i] = tmp;
+        }
+    }    
 
-                        if (i1 != j1) {
-                            B[j1][i1] = A[i1][j1];
-                        }
-                    }
-                    // filling diagonal
-                    if (i == j) {
-                        B[i1][i1] = A[i1][i1];
+}
+
+/*
+ * transpose_tiled - Transpose A in rows x cols tiles, for any M and N.
+ *     Each diagonal element is written after the rest of its tile row:
+ *     A and B map to the same sets, so B[i][i] would evict the line of
+ *     A row i that the row is still reading.
+ */
+void transpose_tiled(int M, int N, int A[N][M], int B[M][N], int rows, int cols)
+{
+    int i, j, i1, j1, diag = 0;
+
+    for (i = 0; i < N; i += rows) {
+        for (j = 0; j < M; j += cols) {
+            for (i1 = i; i1 < i + rows && i1 < N; i1++) {
+                for (j1 = j; j1 < j + cols && j1 < M; j1++) {
+                    if (i1 == j1) {
+                        diag = A[i1][j1];
+                    } else {
+                        B[j1][i1] = A[i1][j1];
                     }
                 }
+                if (i1 >= j && i1 < j + cols && i1 < M) {
+                    B[i1][i1] = diag;
+                }
             }
         }
-    } else if (M == 64) {
-        // iteration thru blocks
-        for (j = 0; j < M; j += blkSize64) {
-            for (i = 0; i < M; i += blkSize64) {
+    }
+}
 
-                // iteration thru row of blocks
-                for (i1 = i; i1 < i + blkSize64; i1 += 1) {
+/*
+ * transpose_tuned - transpose_tiled with the tile size that simulated
+ *     best for the shape (test-trans -S prints these), or 8 x 8 tiles,
+ *     one cache line of A per tile row, for shapes not in the table.
+ */
+static const struct {
+    int M, N, rows, cols;
+} tuned_tiles[] = {
+    {32, 32, 8, 8},
+    {64, 64, 8, 4},
+    {61, 67, 24, 8},
+    {48, 48, 8, 8},
+    {96, 96, 8, 8},
+    {100, 37, 24, 4},
+    {37, 100, 4, 2},
+    {128, 128, 8, 2},
+    {255, 255, 2, 32},
+    {256, 256, 2, 8},
+};
 
-                    // iteration thru col of blocks
-                    for (j1 = j; j1 < j + blkSize64; j1 += 1) {
+char transpose_tuned_desc[] = "Blocked transpose, tile size tuned per shape";
+void transpose_tuned(int M, int N, int A[N][M], int B[M][N])
+{
+    int k;
 
-                        if (i1 != j1) {
-                            B[j1][i1] = A[i1][j1];
-                        }
-                    }
-                    if (i == j) {
-                        B[i1][i1] = A[i1][i1];
-                    }
-                }
+    for (k = 0; k < sizeof(tuned_tiles) / sizeof(tuned_tiles[0]); k++) {
+        if (tuned_tiles[k].M == M && tuned_tiles[k].N == N) {
+            transpose_tiled(M, N, A, B, tuned_tiles[k].rows, tuned_tiles[k].cols);
+            return;
+        }
+    }
+    transpose_tiled(M, N, A, B, 8, 8);
+}
+
+/*
+ * transpose_edges - Transpose what lies outside the largest top-left
+ *     corner of A whose sides are multiples of 8, for the 8 x 8 kernels
+ */
+static void transpose_edges(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j;
+
+    for (i = 0; i < N; i++) {
+        for (j = M - M % 8; j < M; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+    for (i = N - N % 8; i < N; i++) {
+        for (j = 0; j < M - M % 8; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+}
+
+/*
+ * transpose_staged - 8 x 8 tiles, each row of a tile read into registers
+ *     before any of it is written, so the diagonal needs no special case.
+ *     This is the 32 x 32 solution.
+ */
+char transpose_staged_desc[] = "8 x 8 tiles, rows staged in registers";
+void transpose_staged(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, k, t0, t1, t2, t3, t4, t5, t6, t7;
+
+    for (i = 0; i + 8 <= N; i += 8) {
+        for (j = 0; j + 8 <= M; j += 8) {
+            for (k = i; k < i + 8; k++) {
+                t0 = A[k][j];
+                t1 = A[k][j + 1];
+                t2 = A[k][j + 2];
+                t3 = A[k][j + 3];
+                t4 = A[k][j + 4];
+                t5 = A[k][j + 5];
+                t6 = A[k][j + 6];
+                t7 = A[k][j + 7];
+                B[j][k] = t0;
+                B[j + 1][k] = t1;
+                B[j + 2][k] = t2;
+                B[j + 3][k] = t3;
+                B[j + 4][k] = t4;
+                B[j + 5][k] = t5;
+                B[j + 6][k] = t6;
+                B[j + 7][k] = t7;
             }
         }
-    } else if (M == 61) {
-        // iteration thru blocks
-        for (j = 0; j < M; j += blkSize61) {
-            for (i = 0; i < N; i += blkSize61) {
-
-                // iteration thru row of blocks
-                for (i1 = i; i1 < i + blkSize61 && (i1 < N); i1 += 1) {
-
-                    // iteration thru col of blocks
-                    for (j1 = j; j1 < j + blkSize61 && (j1 < M); j1 += 1) {
-                        
-                        if (i1 != j1) {
-                            B[j1][i1] = A[i1][j1];
-                        }
-                    }
-                    if (i == j) {
-                        B[i1][i1] = A[i1][i1];
-                    }
-                }
+    }
+    transpose_edges(M, N, A, B);
+}
+
+/*
+ * transpose_halves - 8 x 8 tiles moved as 4 x 4 quarters, for row lengths
+ *     where rows four apart share a set (64 x 64): a plain 8 x 8 tile of B
+ *     would evict itself, and 4 x 4 tiles use half of every line. The top
+ *     half of the A tile goes to B's top half, its right quarter parked in
+ *     B's top-right until the bottom-left quarter of A replaces it, column
+ *     by column, while the parked values move down to B's bottom-left.
+ */
+char transpose_halves_desc[] = "8 x 8 tiles in 4 x 4 quarters";
+void transpose_halves(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, k, t0, t1, t2, t3, t4, t5, t6, t7;
+
+    for (i = 0; i + 8 <= N; i += 8) {
+        for (j = 0; j + 8 <= M; j += 8) {
+            // A top half: left quarter to place, right quarter parked
+            for (k = i; k < i + 4; k++) {
+                t0 = A[k][j];
+                t1 = A[k][j + 1];
+                t2 = A[k][j + 2];
+                t3 = A[k][j + 3];
+                t4 = A[k][j + 4];
+                t5 = A[k][j + 5];
+                t6 = A[k][j + 6];
+                t7 = A[k][j + 7];
+                B[j][k] = t0;
+                B[j + 1][k] = t1;
+                B[j + 2][k] = t2;
+                B[j + 3][k] = t3;
+                B[j][k + 4] = t4;
+                B[j + 1][k + 4] = t5;
+                B[j + 2][k + 4] = t6;
+                B[j + 3][k + 4] = t7;
+            }
+            // A bottom-left into B top-right; parked row down to B bottom-left
+            for (k = j; k < j + 4; k++) {
+                t0 = A[i + 4][k];
+                t1 = A[i + 5][k];
+                t2 = A[i + 6][k];
+                t3 = A[i + 7][k];
+                t4 = B[k][i + 4];
+                t5 = B[k][i + 5];
+                t6 = B[k][i + 6];
+                t7 = B[k][i + 7];
+                B[k][i + 4] = t0;
+                B[k][i + 5] = t1;
+                B[k][i + 6] = t2;
+                B[k][i + 7] = t3;
+                B[k + 4][i] = t4;
+                B[k + 4][i + 1] = t5;
+                B[k + 4][i + 2] = t6;
+                B[k + 4][i + 3] = t7;
+            }
+            // A bottom-right quarter
+            for (k = j + 4; k < j + 8; k++) {
+                t0 = A[i + 4][k];
+                t1 = A[i + 5][k];
+                t2 = A[i + 6][k];
+                t3 = A[i + 7][k];
+                B[k][i + 4] = t0;
+                B[k][i + 5] = t1;
+                B[k][i + 6] = t2;
+                B[k][i + 7] = t3;
             }
         }
     }
+    transpose_edges(M, N, A, B);
 }
 
-/* 
- * You can define additional transpose functions below. We've defined
- * a simple one below to help you get started. 
- */ 
+/*
+ * transpose_rec - Transpose rows r0..r1-1, columns c0..c1-1 of A by
+ *     halving the longer side until the piece is at most REC_CUTOFF on
+ *     both, without reference to any cache size. The cutoff only bounds
+ *     the call overhead.
+ */
+#define REC_CUTOFF 4
+static void transpose_rec(int M, int N, int A[N][M], int B[M][N],
+                          int r0, int r1, int c0, int c1)
+{
+    int i, j;
 
-/* 
- * trans - A simple baseline transpose function, not optimized for the cache.
+    if (r1 - r0 > REC_CUTOFF || c1 - c0 > REC_CUTOFF) {
+        if (r1 - r0 >= c1 - c0) {
+            transpose_rec(M, N, A, B, r0, (r0 + r1) / 2, c0, c1);
+            transpose_rec(M, N, A, B, (r0 + r1) / 2, r1, c0, c1);
+        } else {
+            transpose_rec(M, N, A, B, r0, r1, c0, (c0 + c1) / 2);
+            transpose_rec(M, N, A, B, r0, r1, (c0 + c1) / 2, c1);
+        }
+        return;
+    }
+    for (i = r0; i < r1; i++) {
+        for (j = c0; j < c1; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+}
+
+/*
+ * transpose_oblivious - Cache-oblivious recursive transpose
  */
-char trans_desc[] = "Simple row-wise scan transpose";
-void trans(int M, int N, int A[N][M], int B[M][N])
+char transpose_oblivious_desc[] = "Cache-oblivious recursive transpose";
+void transpose_oblivious(int M, int N, int A[N][M], int B[M][N])
 {
-    int i, j, tmp;
+    transpose_rec(M, N, A, B, 0, N, 0, M);
+}
 
-    for (i = 0; i < N; i++) {
-        for (j = 0; j < M; j++) {
-            tmp = A[i][j];
-            B[j][i] = tmp;
+/*
+ * transpose_swap - Transpose the n x n matrix at a in place, in size x size
+ *     blocks (size at most 8). A block above the diagonal trades places
+ *     with its mirror a row at a time: the row is held in locals while it
+ *     is swapped with the mirror's column, then written back, so each pair
+ *     of blocks costs one pass over both.
+ */
+static void transpose_swap(int *a, int n, int size)
+{
+    int i, j, k, c, t, row[8];
+
+    for (i = 0; i < n; i += size) {
+        // Diagonal block: swap across its own diagonal
+        for (k = i; k < i + size && k < n; k++) {
+            for (c = k + 1; c < i + size && c < n; c++) {
+                t = a[k * n + c];
+                a[k * n + c] = a[c * n + k];
+                a[c * n + k] = t;
+            }
         }
-    }    
+        for (j = i + size; j < n; j += size) {
+            for (k = i; k < i + size && k < n; k++) {
+                for (c = j; c < j + size && c < n; c++)
+                    row[c - j] = a[k * n + c];
+                for (c = j; c < j + size && c < n; c++) {
+                    t = a[c * n + k];
+                    a[c * n + k] = row[c - j];
+                    row[c - j] = t;
+                }
+                for (c = j; c < j + size && c < n; c++)
+                    a[k * n + c] = row[c - j];
+            }
+        }
+    }
+}
+
+/*
+ * transpose_cycles - Transpose in place the rows x cols matrix at a whose
+ *     elements are runs of run ints. Position q takes the run from
+ *     q * cols mod (rows * cols - 1), so each cycle of that permutation is
+ *     followed backwards from its first position with one run saved; the
+ *     bit vector moved marks positions already filled, so that every cycle
+ *     is followed once. Both are in in_place_scratch, whose accesses count
+ *     like those to A and B.
+ */
+struct in_place_scratch in_place_scratch;
+
+static void transpose_cycles(int *a, int rows, int cols, int run)
+{
+    unsigned char *moved = in_place_scratch.moved;
+    int *saved = in_place_scratch.saved;
+    int last = rows * cols - 1, start, p, q, k;
+
+    for (k = 0; k <= last / 8; k++)
+        moved[k] = 0;
+    for (start = 1; start < last; start++) {
+        if (moved[start / 8] & (1 << (start % 8)))
+            continue;
+        for (k = 0; k < run; k++)
+            saved[k] = a[start * run + k];
+        for (q = start; ; q = p) {
+            moved[q / 8] |= 1 << (q % 8);
+            p = (int) ((long) q * cols % last);
+            if (p == start)
+                break;
+            for (k = 0; k < run; k++)
+                a[q * run + k] = a[p * run + k];
+        }
+        for (k = 0; k < run; k++)
+            a[q * run + k] = saved[k];
+    }
+}
+
+/*
+ * swap_size - The transpose_swap block side that simulated best for an
+ *     n x n matrix: smaller as rows alias more of the cache, down to plain
+ *     element swaps once every row maps to the same sets
+ */
+static const struct {
+    int n, size;
+} swap_sizes[] = {
+    {64, 4},
+    {128, 2},
+    {255, 1},
+    {256, 1},
+};
+
+static int swap_size(int n)
+{
+    int k;
+
+    for (k = 0; k < sizeof(swap_sizes) / sizeof(swap_sizes[0]); k++) {
+        if (swap_sizes[k].n == n)
+            return swap_sizes[k].size;
+    }
+    return 8;
+}
+
+/*
+ * transpose_in_place - Transpose A without a second matrix: afterwards
+ *     its memory holds the M x N transpose. Square matrices are swapped in
+ *     blocks. When one side is a multiple of the other the matrix is a row
+ *     of squares (or a column of them), transposed by block swaps plus a
+ *     cycle-following pass that moves whole square rows; only other shapes
+ *     follow cycles element by element.
+ */
+char transpose_in_place_desc[] = "In-place transpose: block swaps, cycles of rows";
+void transpose_in_place(int M, int N, int A[N][M])
+{
+    int *a = &A[0][0];
+    int t;
+
+    if (M == N) {
+        transpose_swap(a, M, swap_size(M));
+    } else if (M % N == 0) {
+        // N x kN: gather each N x N square's rows, then transpose it
+        transpose_cycles(a, N, M / N, N);
+        for (t = 0; t < M / N; t++)
+            transpose_swap(a + t * N * N, N, swap_size(N));
+    } else if (N % M == 0) {
+        // kM x M: transpose each square, then interleave their rows
+        for (t = 0; t < N / M; t++)
+            transpose_swap(a + t * M * M, M, swap_size(M));
+        transpose_cycles(a, N / M, M, M);
+    } else {
+        transpose_cycles(a, N, M, 1);
+    }
+}
 
+/*
+ * transpose_in_place_cycles - Element by element cycle following for any
+ *     shape, the baseline for transpose_in_place
+ */
+char transpose_in_place_cycles_desc[] = "In-place transpose: cycles of elements";
+void transpose_in_place_cycles(int M, int N, int A[N][M])
+{
+    transpose_cycles(&A[0][0], N, M, 1);
 }
 
 /*
@@ -130,6 +436,12 @@ void registerFunctions()
 
     /* Register any additional transpose functions */
     registerTransFunction(trans, trans_desc); 
+    registerTransFunction(transpose_tuned, transpose_tuned_desc);
+    registerTransFunction(transpose_staged, transpose_staged_desc);
+    registerTransFunction(transpose_halves, transpose_halves_desc);
+    registerTransFunction(transpose_oblivious, transpose_oblivious_desc);
+    registerInPlaceFunction(transpose_in_place, transpose_in_place_desc);
+    registerInPlaceFunction(transpose_in_place_cycles, transpose_in_place_cycles_desc);
 }
 
 /* 
@@ -46,9 +46,10 @@ typedef struct range_t {
 
 /* Characterizes a single trace operation (allocator request) */
 typedef struct {
-    enum {ALLOC, FREE, REALLOC} type; /* type of request */
+    enum {ALLOC, FREE, REALLOC, ALLOC_BATCH, FREE_BATCH} type; /* type of request */
     int index;                        /* index for free() to use later */
     int size;                         /* byte size of alloc/realloc request */
+    int count;                        /* number of consecutive ids for batch requests */
 } traceop_t;
 
 /* Holds the information for one trace file*/
@@ -60,6 +61,7 @@ typedef struct {
     traceop_t *ops;      /* array of requests */
     char **blocks;       /* array of ptrs returned by malloc/realloc... */
     size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+    void **batch;        /* scratch array of num_ids ptrs for batch requests */
 } trace_t;
 
 /* 
@@ -477,7 +479,7 @@ static trace_t *read_trace(char *tracedir, char *filename)
     trace_t *trace;
     char type[MAXLINE];
     char path[MAXLINE];
-    unsigned index, size;
+    unsigned index, size, count;
     unsigned max_index = 0;
     unsigned op_index;
 
@@ -514,6 +516,11 @@ static trace_t *read_trace(char *tracedir, char *filename)
     if ((trace->block_sizes = 
 	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
 	unix_error("malloc 4 failed in read_trace");
+
+    /* ... and scratch space for passing pointers to the batch routines */
+    if ((trace->batch = 
+	 (void **)malloc(trace->num_ids * sizeof(void *))) == NULL)
+	unix_error("malloc 5 failed in read_trace");
     
     /* read every request line in the trace file */
     index = 0;
@@ -539,6 +546,23 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	    trace->ops[op_index].type = FREE;
 	    trace->ops[op_index].index = index;
 	    break;
+	case 'A': /* A <first id> <count> <size>: batch alloc of ids first..first+count-1 */
+	    fscanf(tracefile, "%u %u %u", &index, &count, &size);
+	    assert(count > 0);
+	    trace->ops[op_index].type = ALLOC_BATCH;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].count = count;
+	    trace->ops[op_index].size = size;
+	    max_index = (index + count - 1 > max_index) ? index + count - 1 : max_index;
+	    break;
+	case 'F': /* F <first id> <count>: batch free of ids first..first+count-1 */
+	    fscanf(tracefile, "%u %u", &index, &count);
+	    assert(count > 0);
+	    trace->ops[op_index].type = FREE_BATCH;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].count = count;
+	    max_index = (index + count - 1 > max_index) ? index + count - 1 : max_index;
+	    break;
 	default:
 	    printf("Bogus type character (%c) in tracefile %s\n", 
 		   type[0], path);
@@ -555,14 +579,15 @@ static trace_t *read_trace(char *tracedir, char *filename)
 }
 
 /*
- * free_trace - Free the trace record and the three arrays it points
+ * free_trace - Free the trace record and the four arrays it points
  *              to, all of which were allocated in read_trace().
  */
 void free_trace(trace_t *trace)
 {
-    free(trace->ops);         /* free the three arrays... */
+    free(trace->ops);         /* free the four arrays... */
     free(trace->blocks);      
     free(trace->block_sizes);
+    free(trace->batch);
     free(trace);              /* and the trace record itself... */
 }
 
@@ -576,9 +601,10 @@ void free_trace(trace_t *trace)
  */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges) 
 {
-    int i, j;
+    int i, j, k;
     int index;
     int size;
+    int count;
     int oldsize;
     char *newp;
     char *oldp;
@@ -674,6 +700,42 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    mm_free(p);
 	    break;
 
+        case ALLOC_BATCH: /* mm_malloc_batch */
+
+	    /* Call the student's batch malloc */
+	    count = trace->ops[i].count;
+	    if (mm_malloc_batch(size, count, trace->batch) < 0) {
+		malloc_error(tracenum, i, "mm_malloc_batch failed.");
+		return 0;
+	    }
+
+	    /* Each block in the batch is checked just like a single malloc */
+	    for (k = 0; k < count; k++) {
+		p = trace->batch[k];
+		if (p == NULL) {
+		    malloc_error(tracenum, i, "mm_malloc_batch returned NULL block.");
+		    return 0;
+		}
+		if (add_range(ranges, p, size, tracenum, i) == 0)
+		    return 0;
+		memset(p, (index + k) & 0xFF, size);
+		trace->blocks[index + k] = p;
+		trace->block_sizes[index + k] = size;
+	    }
+	    break;
+
+        case FREE_BATCH: /* mm_free_batch */
+
+	    /* Remove regions from list and call student's batch free */
+	    count = trace->ops[i].count;
+	    for (k = 0; k < count; k++) {
+		p = trace->blocks[index + k];
+		remove_range(ranges, p);
+		trace->batch[k] = p;
+	    }
+	    mm_free_batch(trace->batch, count);
+	    break;
+
 	default:
 	    app_error("Nonexistent request type in eval_mm_valid");
         }
@@ -697,9 +759,9 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  */
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 {   
-    int i;
+    int i, k;
     int index;
-    int size, newsize, oldsize;
+    int size, newsize, oldsize, count;
     int max_total_size = 0;
     int total_size = 0;
     char *p;
@@ -768,6 +830,39 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    
 	    break;
 
+	case ALLOC_BATCH: /* mm_malloc_batch */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    count = trace->ops[i].count;
+
+	    if (mm_malloc_batch(size, count, trace->batch) < 0)
+		app_error("mm_malloc_batch failed in eval_mm_util");
+
+	    /* Remember regions and sizes */
+	    for (k = 0; k < count; k++) {
+		trace->blocks[index + k] = trace->batch[k];
+		trace->block_sizes[index + k] = size;
+	    }
+
+	    /* Keep track of current total size
+	     * of all allocated blocks */
+	    total_size += size * count;
+
+	    /* Update statistics */
+	    max_total_size = (total_size > max_total_size) ?
+		total_size : max_total_size;
+	    break;
+
+	case FREE_BATCH: /* mm_free_batch */
+	    index = trace->ops[i].index;
+	    count = trace->ops[i].count;
+	    for (k = 0; k < count; k++) {
+		trace->batch[k] = trace->blocks[index + k];
+		total_size -= trace->block_sizes[index + k];
+	    }
+	    mm_free_batch(trace->batch, count);
+	    break;
+
 	default:
 	    app_error("Nonexistent request type in eval_mm_util");
 
@@ -784,7 +879,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
  */
 static void eval_mm_speed(void *ptr)
 {
-    int i, index, size, newsize;
+    int i, k, index, size, newsize, count;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
 
@@ -820,6 +915,24 @@ static void eval_mm_speed(void *ptr)
             mm_free(block);
             break;
 
+        case ALLOC_BATCH: /* mm_malloc_batch */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            count = trace->ops[i].count;
+            if (mm_malloc_batch(size, count, trace->batch) < 0)
+		app_error("mm_malloc_batch error in eval_mm_speed");
+            for (k = 0; k < count; k++)
+                trace->blocks[index + k] = trace->batch[k];
+            break;
+
+        case FREE_BATCH: /* mm_free_batch */
+            index = trace->ops[i].index;
+            count = trace->ops[i].count;
+            for (k = 0; k < count; k++)
+                trace->batch[k] = trace->blocks[index + k];
+            mm_free_batch(trace->batch, count);
+            break;
+
 	default:
 	    app_error("Nonexistent request type in eval_mm_valid");
         }
@@ -833,7 +946,7 @@ static void eval_mm_speed(void *ptr)
  */
 static int eval_libc_valid(trace_t *trace, int tracenum)
 {
-    int i, newsize;
+    int i, k, newsize;
     char *p, *newp, *oldp;
 
     for (i = 0;  i < trace->num_ops;  i++) {
@@ -861,6 +974,21 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 	    free(trace->blocks[trace->ops[i].index]);
 	    break;
 
+	case ALLOC_BATCH: /* libc has no batch malloc, so call malloc count times */
+	    for (k = 0; k < trace->ops[i].count; k++) {
+		if ((p = malloc(trace->ops[i].size)) == NULL) {
+		    malloc_error(tracenum, i, "libc malloc failed");
+		    unix_error("System message");
+		}
+		trace->blocks[trace->ops[i].index + k] = p;
+	    }
+	    break;
+
+	case FREE_BATCH: /* free */
+	    for (k = 0; k < trace->ops[i].count; k++)
+		free(trace->blocks[trace->ops[i].index + k]);
+	    break;
+
 	default:
 	    app_error("invalid operation type  in eval_libc_valid");
 	}
@@ -876,7 +1004,7 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
  */
 static void eval_libc_speed(void *ptr)
 {
-    int i;
+    int i, k;
     int index, size, newsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
@@ -906,6 +1034,22 @@ static void eval_libc_speed(void *ptr)
 	    block = trace->blocks[index];
 	    free(block);
 	    break;
+
+	case ALLOC_BATCH: /* malloc */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    for (k = 0; k < trace->ops[i].count; k++) {
+		if ((p = malloc(size)) == NULL)
+		    unix_error("malloc failed in eval_libc_speed");
+		trace->blocks[index + k] = p;
+	    }
+	    break;
+
+	case FREE_BATCH: /* free */
+	    index = trace->ops[i].index;
+	    for (k = 0; k < trace->ops[i].count; k++)
+		free(trace->blocks[index + k]);
+	    break;
 	}
     }
 }
@@ -3,6 +3,8 @@
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include "mm.h"
 #include "memlib.h"
 
@@ -25,6 +27,7 @@ team_t team = {
 #define DSIZE 8
 #define MIN_BLOCK_SIZE 24
 #define CHUNKSIZE (1<<8)
+#define MAX_BLOCK_SIZE ((size_t) (UINT_MAX & ~0x7)) // largest size a 4 B header holds
 
 /** Macro interface */
 // Given a block pointer bp, get the value of its 'prev' pointer.
@@ -53,7 +56,7 @@ team_t team = {
 #define PREV_BLKP(bp) ((char *) (bp) - (GET((char *) (bp) - DSIZE) & ~0x7))
 
 /* Heapchecker - comment/uncomment to disable and enable */
-//#define checkheap(lineno) printf("%s: ", __func__); (mm_check(lineno))
+//#define checkheap(lineno) printf("%s: called from %d.\n", __func__, lineno); if (mm_check(lineno)) exit(-1)
 #define checkheap(lineno)
 
 static void* heap_ptr; // pointer to very beginning of heap
@@ -61,7 +64,9 @@ static void* sentinel; // pointer to beginning of linked list of free blocks
 static void* coalesce(void* bp);
 static void place(void *bp, size_t allocSize);
 static void* extend_heap(size_t words);
-void mm_check(int lineno);
+int mm_check(int lineno);
+static size_t adjust_size(size_t payloadSize);
+static int cmp_addr(const void* a, const void* b);
 inline static void insert_block(void* bp);
 inline static void remove_block(void* bp);
 
@@ -211,22 +216,11 @@ inline static void insert_block(void* bp) {
  * if payloadSize is negative, behavior is undefined.
  */
 void* mm_malloc(size_t payloadSize) {
-    size_t adjustedSize;
-
-    /* Adjust block size to include overhead and alignment reqs. 
-    The next & prev pointer and a header & footer take up 24 B-- thus, this is
-    the minimum block size. The payload area will be 24 - 4 - 4 = 16 B.
-
-    If <= 16 B is requested, data will fit in the minimum block size of 24. 
-    Else, round up to the nearest multiple of 8 and add 8 for the header & footer.
-    For example, 17 becomes 24, then 32. */
     if (payloadSize == 0) {
         return NULL;
-    } else if (payloadSize <= 2*DSIZE) {
-        adjustedSize = MIN_BLOCK_SIZE;
-    } else {
-        adjustedSize = DSIZE * ((payloadSize + DSIZE + (DSIZE-1)) / DSIZE);
     }
+    size_t adjustedSize = adjust_size(payloadSize);
+
     /* Traverse the linked list until a fit is found. Start at sentinel.next.
     If sentinel.next = sentinel, loop immediately terminates. If sentinel.next
     != sentinel, but no fit found, bp eventually equals sentinel. */
@@ -251,6 +245,78 @@ void* mm_malloc(size_t payloadSize) {
     return bp;
 }
 
+/* Adjust block size to include overhead and alignment reqs. 
+ * The next & prev pointer and a header & footer take up 24 B-- thus, this is
+ * the minimum block size. The payload area will be 24 - 4 - 4 = 16 B.
+ *
+ * If <= 16 B is requested, data will fit in the minimum block size of 24. 
+ * Else, round up to the nearest multiple of 8 and add 8 for the header & footer.
+ * For example, 17 becomes 24, then 32.
+ */
+static size_t adjust_size(size_t payloadSize) {
+    if (payloadSize <= 2*DSIZE) {
+        return MIN_BLOCK_SIZE;
+    }
+    return DSIZE * ((payloadSize + DSIZE + (DSIZE-1)) / DSIZE);
+}
+
+/* Allocate n blocks of the same payload size in a single pass. One free block
+ * large enough for all n blocks is found (or the heap is extended once), then
+ * the blocks are carved out of it back to back. The block pointers are written
+ * to out[0..n-1] in increasing address order.
+ *
+ * Returns 0 if successful, -1 if error (out is left untouched), including a
+ * run too large for one block header to hold its size.
+ */
+int mm_malloc_batch(size_t payloadSize, size_t n, void** out) {
+    if (n == 0) {
+        return 0;
+    }
+    if (payloadSize == 0 || payloadSize > MAX_BLOCK_SIZE - DSIZE) {
+        return -1;
+    }
+    size_t adjustedSize = adjust_size(payloadSize);
+    if (n > SIZE_MAX / adjustedSize || adjustedSize * n > MAX_BLOCK_SIZE) {
+        return -1;
+    }
+    size_t totalSize = adjustedSize * n;
+
+    // First fit for the whole run, same traversal as mm_malloc
+    void* bp = NEXT(sentinel);
+    while (bp != sentinel && GET_SIZE(bp) < totalSize) {
+        bp = NEXT(bp);
+    }
+    if (bp == sentinel) {
+        size_t extendSize = (totalSize > CHUNKSIZE) ? totalSize : CHUNKSIZE;
+        bp = extend_heap(extendSize / WSIZE);
+        if (bp == NULL) {
+            return -1;
+        }
+    }
+    remove_block(bp);
+
+    // Carve the run; the last block absorbs a remainder too small to split
+    size_t remainder = GET_SIZE(bp) - totalSize;
+    char* curr = bp;
+    for (size_t i = 0; i < n; i += 1) {
+        size_t size = adjustedSize;
+        if (i == n - 1 && remainder < MIN_BLOCK_SIZE) {
+            size += remainder;
+        }
+        PUT(HDRP(curr), size, 1);
+        PUT(FTRP(curr), size, 1);
+        out[i] = curr;
+        curr = NEXT_BLKP(curr);
+    }
+    if (remainder >= MIN_BLOCK_SIZE) {
+        PUT(HDRP(curr), remainder, 0);
+        PUT(FTRP(curr), remainder, 0);
+        insert_block(curr);
+    }
+    checkheap(__LINE__);
+    return 0;
+}
+
 /* Place the requested allocated block within the block, splits the excess,
  * and sets bp to the address of the newly allocated block.
  *
@@ -296,6 +362,41 @@ void mm_free(void* bp) {
     checkheap(__LINE__);
 }
 
+/* Orders block pointers by address, for qsort */
+static int cmp_addr(const void* a, const void* b) {
+    char* pa = *(char**) a;
+    char* pb = *(char**) b;
+    return (pa > pb) - (pa < pb);
+}
+
+/* mm_free_batch - free n blocks at once. ptrs is sorted by address in place so
+ * that runs of physically adjacent blocks can be merged into a single free
+ * block, which is then coalesced with its neighbours only once.
+ * NULL entries are ignored.
+ */
+void mm_free_batch(void** ptrs, size_t n) {
+    qsort(ptrs, n, sizeof(void*), cmp_addr);
+
+    size_t i = 0;
+    while (i < n) {
+        char* bp = ptrs[i];
+        i += 1;
+        if (bp == NULL) {
+            continue;
+        }
+        // Extend the run while the next pointer is the adjacent block
+        size_t size = GET_SIZE(bp);
+        while (i < n && ptrs[i] == bp + size) {
+            size += GET_SIZE(ptrs[i]);
+            i += 1;
+        }
+        PUT(HDRP(bp), size, 0);
+        PUT(FTRP(bp), size, 0);
+        coalesce(bp);
+    }
+    checkheap(__LINE__);
+}
+
 /* mm_realloc - realloc payload data that ptr points to to a new payload of newSize.
  * If ptr = NULL, equivalent to mm_malloc(size).
  * If size is equal to zero, equivalent to mm_free(ptr).
@@ -316,12 +417,16 @@ void* mm_realloc(void* ptr, size_t newSize) {
         return NULL;
 
     } else { // ptr is not null and size != 0
-        size_t currSize = GET_SIZE(ptr);
+        // Payload capacity of the block excludes the header & footer
+        size_t currSize = GET_SIZE(ptr) - DSIZE;
         if (newSize == currSize) {
             return ptr;
         } else {
             // Search for new free block, copy the payload, free old block
             new_ptr = mm_malloc(newSize);
+            if (new_ptr == NULL) {
+                return NULL;
+            }
             if (newSize < currSize) {
                 memcpy(new_ptr, ptr, newSize);
             } else {
@@ -334,16 +439,17 @@ void* mm_realloc(void* ptr, size_t newSize) {
     }
 }
 
-/* Checks the heap for correctness. Call this function using checkheap(__LINE__) */
-void mm_check(int lineno) {
-    printf("called from %d.\n", lineno);
-
+/* Checks the heap for correctness. Call this function using checkheap(__LINE__).
+ * 
+ * Returns 0 if the heap is consistent, -1 (after printing the error) if not.
+ */
+int mm_check(int lineno) {
     // Is every free block actually in the free list?
     void* bp = NEXT(sentinel);
     while (bp != sentinel) {
         if (GET_ALLOC(bp)) {
             printf("ERROR: Not all blocks in linked list are free\n");
-            exit(-1);
+            return -1;
         }
         bp = NEXT(bp);
     }
@@ -354,16 +460,17 @@ void mm_check(int lineno) {
         // Do headers and footers match?
         if (GET(HDRP(bp)) != GET(FTRP(bp))) {
             printf("ERROR: Not all header-footer pairs match\n");
-            exit(-1);
+            return -1;
         }
         // Are there any contiguous free blocks that somehow escaped coalescing?
         currIsFree = !GET_ALLOC(bp);
         //printf("%p, %d, %d\n", bp, GET_SIZE(bp), currIsFree);
         if (currIsFree && prevIsFree) {
             printf("ERROR: not all continguous free blocks are coalesced\n");
-            exit(-1);
+            return -1;
         }
         prevIsFree = currIsFree;
         bp = NEXT_BLKP(bp);
     }
-}
\ No newline at end of file
+    return 0;
+}
@@ -4,6 +4,9 @@ extern int mm_init (void);
 extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
+extern int mm_malloc_batch(size_t size, size_t n, void **out);
+extern void mm_free_batch(void **ptrs, size_t n);
+extern int mm_check(int lineno);
 
 /* 
  * Students work in teams of one or two.  Teams enter their team name, 
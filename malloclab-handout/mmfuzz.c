@@ -0,0 +1,420 @@
+/*
+ * mmfuzz.c - Randomized and libFuzzer-driven tester for the mm package
+ *
+ * A sequence of malloc/free/realloc requests is replayed against mm.c
+ * while a shadow model remembers every live block, its payload size and
+ * the byte it was filled with. After every request the harness checks
+ * that
+ *   - returned payloads are ALIGNMENT-aligned and lie inside the heap,
+ *   - no two live payloads overlap,
+ *   - the payloads of freed and realloc'd blocks were not clobbered,
+ *   - mm_realloc preserved the old payload,
+ * and every -c requests it also runs mm_check over the whole heap.
+ *
+ * When a sequence fails it is shrunk (delta debugging over the request
+ * list) and written out as a .rep trace that mdriver can replay:
+ *
+ *   unix> mmfuzz -s 1 -n 1000 -o fail.rep
+ *   unix> mdriver -V -f fail.rep
+ *
+ * Built with -DMM_LIBFUZZER (see the mmfuzz-libfuzzer Makefile target)
+ * the same checks run from LLVMFuzzerTestOneInput instead of main.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "config.h"
+
+#define MAXSLOTS   64    /* number of distinct block ids in a sequence */
+#define MAXOPS     4096  /* longest sequence we replay */
+#define OPBYTES    4     /* bytes of fuzzer input per request */
+#define MAXLINE    1024
+
+/* Returns true if p is ALIGNMENT-byte aligned */
+#define IS_ALIGNED(p)  ((((unsigned long)(p)) % ALIGNMENT) == 0)
+
+/* One allocator request, in the same terms as an mdriver trace line */
+typedef struct {
+    char type; /* 'a', 'f' or 'r' */
+    int id;    /* block id, 0..MAXSLOTS-1 */
+    int size;  /* payload size for 'a' and 'r' */
+} fuzzop_t;
+
+/* Shadow state of one block id */
+typedef struct {
+    char *p;   /* payload, NULL if not live */
+    int size;  /* payload size */
+    char fill; /* byte the payload was filled with */
+} slot_t;
+
+static slot_t slots[MAXSLOTS];
+static int check_every = 1;   /* run mm_check every this many requests (0 = never) */
+static int verbose = 0;
+static char why[MAXLINE];     /* reason for the last failure */
+
+/*
+ * decode - Turn raw bytes into requests. Every OPBYTES bytes encode the
+ *     request type, the block id and a payload size. Small sizes are
+ *     much more common than large ones, as in the real traces.
+ */
+static int decode(const uint8_t *data, size_t len, fuzzop_t *ops)
+{
+    int n = 0;
+    size_t i;
+
+    for (i = 0; i + OPBYTES <= len && n < MAXOPS; i += OPBYTES) {
+	unsigned size;
+	ops[n].type = "aafr"[data[i] & 3];
+	ops[n].id = data[i+1] % MAXSLOTS;
+	size = data[i+2] | (data[i+3] << 8);
+	ops[n].size = (data[i] & 0x80) ? 1 + size : 1 + (size & 0x1ff);
+	n++;
+    }
+    return n;
+}
+
+/*
+ * check_new - Check a block just returned by mm_malloc/mm_realloc
+ *     against the heap bounds and every other live block.
+ */
+static int check_new(int id, char *p, int size)
+{
+    int i;
+    char *hi = p + size - 1;
+
+    if (!IS_ALIGNED(p)) {
+	sprintf(why, "payload %p not aligned to %d bytes", p, ALIGNMENT);
+	return 0;
+    }
+    if (p < (char *)mem_heap_lo() || hi > (char *)mem_heap_hi()) {
+	sprintf(why, "payload (%p:%p) lies outside heap (%p:%p)",
+		p, hi, mem_heap_lo(), mem_heap_hi());
+	return 0;
+    }
+    for (i = 0; i < MAXSLOTS; i++) {
+	slot_t *s = &slots[i];
+	if (i == id || s->p == NULL)
+	    continue;
+	if (p <= s->p + s->size - 1 && s->p <= hi) {
+	    sprintf(why, "payload (%p:%p) overlaps block %d (%p:%p)",
+		    p, hi, i, s->p, s->p + s->size - 1);
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+ * check_intact - Check that a live block still holds its fill byte
+ *     in its first n bytes.
+ */
+static int check_intact(int id, int n)
+{
+    int i;
+    slot_t *s = &slots[id];
+
+    for (i = 0; i < n; i++) {
+	if (s->p[i] != s->fill) {
+	    sprintf(why, "block %d byte %d clobbered (0x%02x, expected 0x%02x)",
+		    id, i, s->p[i] & 0xff, s->fill & 0xff);
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+ * replay - Run ops[0..n-1] on a fresh heap. Requests that make no sense
+ *     for the current shadow state (free of a dead id, malloc of a live
+ *     id) are skipped, so any subsequence of a sequence is replayable.
+ *     If used is non-NULL, used[i] is set for each request executed.
+ *
+ *     Returns -1 if every request succeeded, otherwise the index of the
+ *     failing request (with the reason in why).
+ */
+static int replay(fuzzop_t *ops, int n, char *used)
+{
+    int i, size;
+    char *p;
+    slot_t *s;
+
+    memset(slots, 0, sizeof(slots));
+    mem_reset_brk();
+    if (mm_init() < 0) {
+	sprintf(why, "mm_init failed");
+	return 0;
+    }
+
+    for (i = 0; i < n; i++) {
+	s = &slots[ops[i].id];
+	size = ops[i].size;
+	if (used)
+	    used[i] = 0;
+
+	switch (ops[i].type) {
+	case 'a':
+	    if (s->p != NULL)
+		continue;
+	    if ((p = mm_malloc(size)) == NULL) {
+		/* Only an error if the heap could have held the request */
+		if (mem_heapsize() + 2*size + mem_pagesize() >= MAX_HEAP)
+		    continue;
+		sprintf(why, "mm_malloc(%d) failed", size);
+		return i;
+	    }
+	    if (!check_new(ops[i].id, p, size))
+		return i;
+	    s->p = p;
+	    s->size = size;
+	    s->fill = (char) (i * 31 + 7);
+	    memset(p, s->fill, size);
+	    break;
+
+	case 'f':
+	    if (s->p == NULL)
+		continue;
+	    if (!check_intact(ops[i].id, s->size))
+		return i;
+	    mm_free(s->p);
+	    s->p = NULL;
+	    break;
+
+	case 'r':
+	    if (s->p == NULL)
+		continue;
+	    if (!check_intact(ops[i].id, s->size))
+		return i;
+	    if ((p = mm_realloc(s->p, size)) == NULL) {
+		if (mem_heapsize() + 2*size + mem_pagesize() >= MAX_HEAP)
+		    continue;
+		sprintf(why, "mm_realloc(%d) failed", size);
+		return i;
+	    }
+	    s->p = NULL; /* the old payload may be reused by p */
+	    if (!check_new(ops[i].id, p, size))
+		return i;
+	    s->p = p;
+	    if (!check_intact(ops[i].id, size < s->size ? size : s->size)) {
+		sprintf(why, "mm_realloc did not preserve the data of block %d",
+			ops[i].id);
+		return i;
+	    }
+	    s->size = size;
+	    s->fill = (char) (i * 31 + 7);
+	    memset(p, s->fill, size);
+	    break;
+	}
+
+	if (used)
+	    used[i] = 1;
+	if (check_every && i % check_every == 0 && mm_check(i) != 0) {
+	    sprintf(why, "mm_check failed");
+	    return i;
+	}
+    }
+
+    /* A final sweep catches blocks clobbered by later requests */
+    for (i = 0; i < MAXSLOTS; i++)
+	if (slots[i].p != NULL && !check_intact(i, slots[i].size))
+	    return n - 1;
+    return -1;
+}
+
+/*
+ * minimize - Shrink a failing sequence. First cut everything after the
+ *     failing request, then repeatedly try to drop chunks of requests,
+ *     halving the chunk size whenever no chunk can be dropped.
+ *     Returns the new length.
+ */
+static int minimize(fuzzop_t *ops, int n)
+{
+    static fuzzop_t trial[MAXOPS];
+    int fail, chunk, start, m;
+
+    if ((fail = replay(ops, n, NULL)) < 0)
+	return n;
+    n = fail + 1;
+
+    for (chunk = n / 2; chunk >= 1; ) {
+	int removed = 0;
+	for (start = 0; start < n; start += chunk) {
+	    memcpy(trial, ops, start * sizeof(fuzzop_t));
+	    m = start;
+	    if (start + chunk < n) {
+		memcpy(trial + m, ops + start + chunk,
+		       (n - start - chunk) * sizeof(fuzzop_t));
+		m += n - start - chunk;
+	    }
+	    if (m > 0 && (fail = replay(trial, m, NULL)) >= 0) {
+		memcpy(ops, trial, (fail + 1) * sizeof(fuzzop_t));
+		n = fail + 1;
+		removed = 1;
+		start -= chunk;
+	    }
+	}
+	if (!removed)
+	    chunk /= 2;
+    }
+    return n;
+}
+
+/*
+ * write_rep - Write the requests that actually execute as an mdriver
+ *     trace. Block ids are used directly as trace indices.
+ */
+static int write_rep(char *path, fuzzop_t *ops, int n)
+{
+    static char used[MAXOPS];
+    FILE *fp;
+    int i, num_ops = 0, max_id = 0;
+
+    replay(ops, n, used);
+    used[n-1] = 1; /* the failing request itself */
+    for (i = 0; i < n; i++) {
+	if (!used[i])
+	    continue;
+	num_ops++;
+	if (ops[i].type != 'f' && ops[i].id > max_id)
+	    max_id = ops[i].id;
+    }
+
+    if ((fp = fopen(path, "w")) == NULL) {
+	perror(path);
+	return 0;
+    }
+    fprintf(fp, "%d\n%d\n%d\n%d\n", MAX_HEAP, max_id + 1, num_ops, 1);
+    for (i = 0; i < n; i++) {
+	if (!used[i])
+	    continue;
+	if (ops[i].type == 'f')
+	    fprintf(fp, "f %d\n", ops[i].id);
+	else
+	    fprintf(fp, "%c %d %d\n", ops[i].type, ops[i].id, ops[i].size);
+    }
+    fclose(fp);
+    return 1;
+}
+
+/*
+ * report - Minimize a failing sequence and save it as a trace
+ */
+static void report(fuzzop_t *ops, int n, char *path)
+{
+    int fail = replay(ops, n, NULL);
+
+    printf("FAIL at request %d: %s\n", fail, why);
+    n = minimize(ops, n);
+    fail = replay(ops, n, NULL);
+    printf("minimized to %d requests: %s\n", n, why);
+    if (write_rep(path, ops, n))
+	printf("wrote %s\n", path);
+}
+
+#ifdef MM_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t len)
+{
+    static fuzzop_t ops[MAXOPS];
+    static int initialized = 0;
+    int n;
+
+    if (!initialized) {
+	mem_init();
+	initialized = 1;
+    }
+    n = decode(data, len, ops);
+    if (n > 0 && replay(ops, n, NULL) >= 0) {
+	report(ops, n, "mmfuzz-crash.rep");
+	abort();
+    }
+    return 0;
+}
+
+#else
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mmfuzz [-hv] [-s <seed>] [-n <iters>] [-l <len>] [-c <n>] [-o <file>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-c <n>     Run mm_check every n requests, 0 to disable (default 1).\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-l <len>   Requests per sequence (default 1000, max %d).\n", MAXOPS);
+    fprintf(stderr, "\t-n <iters> Number of random sequences (default 100).\n");
+    fprintf(stderr, "\t-o <file>  Where to write a minimized failing trace (default mmfuzz-fail.rep).\n");
+    fprintf(stderr, "\t-s <seed>  Random seed (default 1).\n");
+    fprintf(stderr, "\t-v         Print progress.\n");
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t data[MAXOPS * OPBYTES];
+    static fuzzop_t ops[MAXOPS];
+    char c;
+    int i, j, n;
+    unsigned seed = 1;
+    int iters = 100;
+    int len = 1000;
+    char *outfile = "mmfuzz-fail.rep";
+
+    while ((c = getopt(argc, argv, "s:n:l:c:o:vh")) != EOF) {
+	switch (c) {
+	case 's':
+	    seed = atoi(optarg);
+	    break;
+	case 'n':
+	    iters = atoi(optarg);
+	    break;
+	case 'l':
+	    len = atoi(optarg);
+	    break;
+	case 'c':
+	    check_every = atoi(optarg);
+	    break;
+	case 'o':
+	    outfile = optarg;
+	    break;
+	case 'v':
+	    verbose = 1;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (len <= 0 || len > MAXOPS || check_every < 0) {
+	usage();
+	exit(1);
+    }
+
+    mem_init();
+    srand(seed);
+    for (i = 0; i < iters; i++) {
+	for (j = 0; j < len * OPBYTES; j++)
+	    data[j] = rand() & 0xff;
+	n = decode(data, len * OPBYTES, ops);
+	if (replay(ops, n, NULL) >= 0) {
+	    printf("seed %u, sequence %d: ", seed, i);
+	    report(ops, n, outfile);
+	    mem_deinit();
+	    exit(1);
+	}
+	if (verbose && (i + 1) % 10 == 0)
+	    printf("%d/%d sequences ok\n", i + 1, iters);
+    }
+    printf("%d sequences of %d requests ok\n", iters, len);
+    mem_deinit();
+    exit(0);
+}
+
+#endif /* MM_LIBFUZZER */
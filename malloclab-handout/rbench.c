@@ -0,0 +1,255 @@
+/*
+ * rbench.c - Region allocator benchmark
+ *
+ * Models request-scoped allocation: each request allocates a batch of
+ * small objects of random sizes and releases all of them when it
+ * finishes. The same workload is run twice on the mm package:
+ *
+ *   mm_free  - every object is released with its own mm_free call
+ *   region   - objects come from region_alloc and are released with
+ *              one region_reset per request
+ *
+ * Both runs are validated first and then timed with fsecs, exactly like
+ * mdriver times a trace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "region.h"
+#include "fsecs.h"
+#include "config.h"
+
+/* Returns true if p is ALIGNMENT-byte aligned */
+#define IS_ALIGNED(p)  ((((unsigned long)(p)) % ALIGNMENT) == 0)
+
+/* Characterizes the synthetic request workload */
+typedef struct {
+    int num_reqs;     /* number of requests */
+    int objs_per_req; /* objects allocated by each request */
+    int chunk_size;   /* region chunk size (0 = default) */
+    int *sizes;       /* objs_per_req object sizes, reused by every request */
+    char **blocks;    /* objs_per_req pointers for the mm_free variant */
+} workload_t;
+
+/* Summarizes one variant of the benchmark */
+typedef struct {
+    char *name;
+    double ops;     /* allocation + release calls */
+    int valid;
+    double secs;
+    size_t heapsize; /* heap size after the run */
+} stats_t;
+
+int verbose = 0; /* used by fsecs.c */
+
+static void unix_error(char *msg);
+static void app_error(char *msg);
+static void usage(void);
+
+/*
+ * run_mm_free - Allocate each request's objects with mm_malloc and
+ *     release them one at a time with mm_free. If check is set, the
+ *     payloads are filled and verified before they are freed.
+ */
+static int run_mm_free(workload_t *w, int check)
+{
+    int i, j, k;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in run_mm_free");
+
+    for (i = 0; i < w->num_reqs; i++) {
+	for (j = 0; j < w->objs_per_req; j++) {
+	    if ((w->blocks[j] = mm_malloc(w->sizes[j])) == NULL)
+		app_error("mm_malloc failed in run_mm_free");
+	    if (check) {
+		if (!IS_ALIGNED(w->blocks[j]))
+		    return 0;
+		memset(w->blocks[j], j & 0xFF, w->sizes[j]);
+	    }
+	}
+	if (check) {
+	    for (j = 0; j < w->objs_per_req; j++)
+		for (k = 0; k < w->sizes[j]; k++)
+		    if (w->blocks[j][k] != (char) (j & 0xFF))
+			return 0;
+	}
+	for (j = 0; j < w->objs_per_req; j++)
+	    mm_free(w->blocks[j]);
+    }
+    return 1;
+}
+
+/*
+ * run_region - Allocate each request's objects from a region and release
+ *     them with a single region_reset.
+ */
+static int run_region(workload_t *w, int check)
+{
+    int i, j, k;
+    char *p;
+    region_t *r;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in run_region");
+    if ((r = region_create(w->chunk_size)) == NULL)
+	app_error("region_create failed in run_region");
+
+    for (i = 0; i < w->num_reqs; i++) {
+	for (j = 0; j < w->objs_per_req; j++) {
+	    if ((p = region_alloc(r, w->sizes[j])) == NULL)
+		app_error("region_alloc failed in run_region");
+	    if (check) {
+		if (!IS_ALIGNED(p))
+		    return 0;
+		w->blocks[j] = p;
+		memset(p, j & 0xFF, w->sizes[j]);
+	    }
+	}
+	if (check) {
+	    for (j = 0; j < w->objs_per_req; j++)
+		for (k = 0; k < w->sizes[j]; k++)
+		    if (w->blocks[j][k] != (char) (j & 0xFF))
+			return 0;
+	}
+	region_reset(r);
+    }
+    region_destroy(r);
+    return 1;
+}
+
+/* fsecs wrappers */
+static void speed_mm_free(void *ptr) { run_mm_free((workload_t *) ptr, 0); }
+static void speed_region(void *ptr) { run_region((workload_t *) ptr, 0); }
+
+/*
+ * printresults - prints a comparison of the benchmark variants
+ */
+static void printresults(int n, stats_t *stats)
+{
+    int i;
+
+    printf("%-8s%7s%10s%10s%8s%10s\n",
+	   "method", " valid", "ops", "secs", "Kops", "heap");
+    for (i = 0; i < n; i++) {
+	if (stats[i].valid)
+	    printf("%-8s%7s%10.0f%10.6f%8.0f%10lu\n",
+		   stats[i].name, "yes", stats[i].ops, stats[i].secs,
+		   (stats[i].ops/1e3)/stats[i].secs,
+		   (unsigned long) stats[i].heapsize);
+	else
+	    printf("%-8s%7s%10s%10s%8s%10s\n",
+		   stats[i].name, "no", "-", "-", "-", "-");
+    }
+    if (stats[0].valid && stats[1].valid)
+	printf("region speedup over mm_free: %.2fx\n",
+	       stats[0].secs / stats[1].secs);
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+    char c;
+    workload_t w = {1000, 64, 0, NULL, NULL};
+    stats_t stats[2];
+
+    while ((c = getopt(argc, argv, "n:k:c:vh")) != EOF) {
+	switch (c) {
+	case 'n': /* Number of requests */
+	    w.num_reqs = atoi(optarg);
+	    break;
+	case 'k': /* Objects per request */
+	    w.objs_per_req = atoi(optarg);
+	    break;
+	case 'c': /* Region chunk size */
+	    w.chunk_size = atoi(optarg);
+	    break;
+	case 'v':
+	    verbose = 1;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (w.num_reqs <= 0 || w.objs_per_req <= 0 || w.chunk_size < 0) {
+	usage();
+	exit(1);
+    }
+
+    /* Object sizes are fixed up front so both variants see the same mix */
+    if ((w.sizes = malloc(w.objs_per_req * sizeof(int))) == NULL)
+	unix_error("malloc failed in main");
+    if ((w.blocks = malloc(w.objs_per_req * sizeof(char *))) == NULL)
+	unix_error("malloc failed in main");
+    srand(27);
+    for (i = 0; i < w.objs_per_req; i++)
+	w.sizes[i] = 8 + rand() % 249; /* 8..256 bytes */
+
+    init_fsecs();
+    mem_init();
+
+    stats[0].name = "mm_free";
+    stats[0].ops = 2.0 * w.num_reqs * w.objs_per_req;
+    stats[0].valid = run_mm_free(&w, 1);
+    stats[0].heapsize = mem_heapsize();
+    if (stats[0].valid)
+	stats[0].secs = fsecs(speed_mm_free, &w);
+
+    stats[1].name = "region";
+    stats[1].ops = (double) w.num_reqs * w.objs_per_req + w.num_reqs;
+    stats[1].valid = run_region(&w, 1);
+    stats[1].heapsize = mem_heapsize();
+    if (stats[1].valid)
+	stats[1].secs = fsecs(speed_region, &w);
+
+    printf("%d requests x %d objects\n", w.num_reqs, w.objs_per_req);
+    printresults(2, stats);
+
+    free(w.sizes);
+    free(w.blocks);
+    mem_deinit();
+    exit(0);
+}
+
+/*
+ * app_error - Report an arbitrary application error
+ */
+static void app_error(char *msg)
+{
+    printf("%s\n", msg);
+    exit(1);
+}
+
+/*
+ * unix_error - Report a Unix-style error
+ */
+static void unix_error(char *msg)
+{
+    printf("%s: %s\n", msg, strerror(errno));
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: rbench [-hv] [-n <reqs>] [-k <objs>] [-c <bytes>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-c <bytes> Region chunk size (default 4096).\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-k <objs>  Objects allocated per request (default 64).\n");
+    fprintf(stderr, "\t-n <reqs>  Number of requests (default 1000).\n");
+    fprintf(stderr, "\t-v         Print timing method.\n");
+}
@@ -0,0 +1,124 @@
+/*
+ * region.c - Region (arena) allocator on top of mm_malloc/mm_free.
+ *
+ * A region is a singly linked list of chunks, newest first. Allocation bumps
+ * a pointer through the newest chunk and only calls mm_malloc when the chunk
+ * is exhausted. Requests larger than the chunk size get a dedicated chunk
+ * that is linked behind the current one, so the bump chunk is not wasted.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include "mm.h"
+#include "region.h"
+
+#define ALIGNMENT 8
+#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~(ALIGNMENT-1))
+#define REGION_CHUNKSIZE 4096
+
+typedef struct chunk {
+    struct chunk *next; /* next (older) chunk in the region */
+} chunk_t;
+
+/* Payload of a chunk starts right after its (padded) header */
+#define CHUNK_HDR ALIGN(sizeof(chunk_t))
+#define CHUNK_DATA(c) ((char *) (c) + CHUNK_HDR)
+
+/* Largest payload whose aligned size plus chunk header fits in a size_t */
+#define MAX_PAYLOAD (SIZE_MAX - CHUNK_HDR - (ALIGNMENT-1))
+
+struct region {
+    chunk_t *chunks;   /* list of chunks, current bump chunk first */
+    char *cur;         /* next free byte in the current chunk */
+    char *end;         /* one past the last byte of the current chunk */
+    size_t chunk_size; /* payload bytes per regular chunk */
+};
+
+/* Get a chunk with room for size bytes of payload. Returns NULL on error. */
+static chunk_t *new_chunk(size_t size) {
+    return (chunk_t *) mm_malloc(CHUNK_HDR + size);
+}
+
+region_t *region_create(size_t chunk_size) {
+    if (chunk_size > MAX_PAYLOAD) {
+        return NULL;
+    }
+    region_t *r = mm_malloc(sizeof(region_t));
+    if (r == NULL) {
+        return NULL;
+    }
+    r->chunk_size = ALIGN(chunk_size ? chunk_size : REGION_CHUNKSIZE);
+    r->chunks = NULL;
+    r->cur = NULL;
+    r->end = NULL;
+    return r;
+}
+
+void *region_alloc(region_t *r, size_t size) {
+    if (size == 0 || size > MAX_PAYLOAD) {
+        return NULL;
+    }
+    size = ALIGN(size);
+
+    // Fast path: bump within the current chunk
+    if ((size_t) (r->end - r->cur) >= size) {
+        void *p = r->cur;
+        r->cur += size;
+        return p;
+    }
+    // Oversized request: dedicated chunk placed behind the bump chunk
+    if (size > r->chunk_size) {
+        chunk_t *c = new_chunk(size);
+        if (c == NULL) {
+            return NULL;
+        }
+        if (r->chunks == NULL) {
+            c->next = NULL;
+            r->chunks = c;
+        } else {
+            c->next = r->chunks->next;
+            r->chunks->next = c;
+        }
+        return CHUNK_DATA(c);
+    }
+    // Current chunk exhausted: start a new one
+    chunk_t *c = new_chunk(r->chunk_size);
+    if (c == NULL) {
+        return NULL;
+    }
+    c->next = r->chunks;
+    r->chunks = c;
+    r->cur = CHUNK_DATA(c) + size;
+    r->end = CHUNK_DATA(c) + r->chunk_size;
+    return CHUNK_DATA(c);
+}
+
+/* Free every chunk in the list starting at c */
+static void free_chunks(chunk_t *c) {
+    while (c != NULL) {
+        chunk_t *next = c->next;
+        mm_free(c);
+        c = next;
+    }
+}
+
+void region_reset(region_t *r) {
+    if (r->chunks == NULL) {
+        return;
+    }
+    // Every chunk holds at least chunk_size bytes, so the oldest one can be
+    // kept as the bump chunk and all newer ones released
+    chunk_t *keep = r->chunks;
+    while (keep->next != NULL) {
+        chunk_t *next = keep->next;
+        mm_free(keep);
+        keep = next;
+    }
+    r->chunks = keep;
+    r->cur = CHUNK_DATA(keep);
+    r->end = CHUNK_DATA(keep) + r->chunk_size;
+}
+
+void region_destroy(region_t *r) {
+    free_chunks(r->chunks);
+    mm_free(r);
+}
@@ -0,0 +1,27 @@
+#include <stddef.h>
+
+/*
+ * region.h - Region (arena) allocator built on top of the mm package.
+ *
+ * Objects are bump-allocated out of chunks obtained with mm_malloc. There
+ * is no per-object free: region_reset releases everything allocated from
+ * the region at once in O(chunks), keeping the first chunk for reuse.
+ */
+
+typedef struct region region_t;
+
+/* region_create - create an empty region whose chunks hold chunk_size bytes
+ * of payload (0 selects REGION_CHUNKSIZE). Returns NULL on error. */
+region_t *region_create(size_t chunk_size);
+
+/* region_alloc - return an ALIGNMENT-aligned block of size bytes, valid
+ * until the next region_reset/region_destroy. Returns NULL on error or if
+ * size is 0. */
+void *region_alloc(region_t *r, size_t size);
+
+/* region_reset - release every object allocated from r. The first chunk is
+ * kept so a region reused per request does not go back to mm_malloc. */
+void region_reset(region_t *r);
+
+/* region_destroy - release every chunk and the region itself */
+void region_destroy(region_t *r);